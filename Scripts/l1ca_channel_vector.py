@@ -0,0 +1,97 @@
+import math
+
+# Cycle model of RTL/source/l1ca_channel.sv (ACTIVE state) and l1ca_code.sv,
+# run on a pseudo-random 1-bit input. Prints the accumulators at the first
+# epochs for GPSL1CATracker::check_integer_nco() in the simulator.
+
+FS = 69.984e6
+FC = 9.334875e6
+DOPPLER = 1000.0
+SV = 1              # PRN, the RTL sv input is SV - 1
+START_CHIP = 1020   # Early chip at the first sample
+EPOCHS = 3
+
+G2_TAPS = [(2, 6), (3, 7), (4, 8), (5, 9), (1, 9), (2, 10), (1, 8), (2, 9),
+           (3, 10), (2, 3), (3, 4), (5, 6), (6, 7), (7, 8), (8, 9), (9, 10),
+           (1, 4), (2, 5), (3, 6), (4, 7), (5, 8), (6, 9), (1, 3), (4, 6),
+           (5, 7), (6, 8), (7, 9), (8, 10), (1, 6), (2, 7), (3, 8), (4, 9)]
+
+
+def llround(x):
+    return int(math.floor(x)) + (1 if x - math.floor(x) >= 0.5 else 0)
+
+
+# Control words as the tracker rounds its initial loop filter rates
+code_rate = (1.023e6 + (DOPPLER * 1.023e6 / 1.57542e9)) / FS
+carrier_rate = (FC + DOPPLER) * 4 / FS
+code_fcw = llround(code_rate * 4294967296.0)
+lo_fcw = llround(carrier_rate * 1073741824.0)
+
+
+def bit(reg, n):
+    return (reg >> (n - 1)) & 1
+
+
+def clock_code(g1, g2):
+    g1 = ((g1 << 1) & 0x3FE) | (bit(g1, 10) ^ bit(g1, 3))
+    g2 = ((g2 << 1) & 0x3FE) | (bit(g2, 10) ^ bit(g2, 9) ^ bit(g2, 8) ^ bit(g2, 6) ^ bit(g2, 3) ^ bit(g2, 2))
+    return g1, g2
+
+
+# Code generator at the start chip
+g1 = 0x3FF
+g2 = 0x3FF
+for _ in range(START_CHIP):
+    g1, g2 = clock_code(g1, g2)
+tap_a, tap_b = G2_TAPS[SV - 1]
+
+code_phase = 0x80000000
+lo_phase = 0
+code_prompt = 0
+code_late = 0
+epoch_reg = 0
+acc = [0] * 6  # ie, qe, ip, qp, il, ql
+
+lcg = 1
+epochs = []
+samples = 0
+while len(epochs) < EPOCHS:
+    # Input sample
+    lcg = (lcg * 1103515245 + 12345) & 0xFFFFFFFF
+    signal_in = lcg >> 31
+
+    code_early = bit(g1, 10) ^ bit(g2, tap_a) ^ bit(g2, tap_b)
+    code_epoch = 1 if g1 == 0x3FF else 0
+
+    # NCOs
+    next_code_phase = code_phase + code_fcw
+    code_strobe = next_code_phase >> 32
+    delay_strobe = ((next_code_phase >> 31) ^ (code_phase >> 31)) & 1
+    lo_sin = [1, 1, 0, 0][lo_phase >> 30]
+    lo_cos = [1, 0, 0, 1][lo_phase >> 30]
+
+    # Mixers and accumulators, cleared on the rising edge of the epoch
+    d = [code_early ^ signal_in ^ lo_sin, code_early ^ signal_in ^ lo_cos,
+         code_prompt ^ signal_in ^ lo_sin, code_prompt ^ signal_in ^ lo_cos,
+         code_late ^ signal_in ^ lo_sin, code_late ^ signal_in ^ lo_cos]
+    if code_epoch and not epoch_reg:
+        epochs.append(list(acc))
+        acc = [0] * 6
+    else:
+        acc = [a + (1 if x else -1) for a, x in zip(acc, d)]
+
+    # Registers
+    if delay_strobe:
+        code_late = code_prompt
+        code_prompt = code_early
+    if code_strobe:
+        g1, g2 = clock_code(g1, g2)
+    epoch_reg = code_epoch
+    code_phase = next_code_phase & 0xFFFFFFFF
+    lo_phase = (lo_phase + lo_fcw) & 0xFFFFFFFF
+    samples += 1
+
+print(f"// From Scripts/l1ca_channel_vector.py: PRN {SV}, doppler {DOPPLER:g} Hz, chip {START_CHIP}, {samples} samples")
+print(f"// code_fcw {code_fcw}, lo_fcw {lo_fcw}")
+for e in epochs:
+    print("    {" + ", ".join(str(a) for a in e) + "},")
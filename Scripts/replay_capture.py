@@ -0,0 +1,65 @@
+# Replay a 1-bit capture at its real-time rate to test TrackerSim's StreamSource
+# Usage: python replay_capture.py <capture.bin> [stdout | tcp:<port> | unix:<path> | <fifo>] [sample rate]
+
+import os
+import socket
+import sys
+import time
+
+CHUNK_SECONDS = 0.001
+
+def open_output(target):
+    if target == "stdout":
+        return sys.stdout.buffer.write, None
+
+    if target.startswith("tcp:") or target.startswith("unix:"):
+        if target.startswith("tcp:"):
+            server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+            server.bind(("127.0.0.1", int(target[4:])))
+        else:
+            if os.path.exists(target[5:]):
+                os.remove(target[5:])
+            server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            server.bind(target[5:])
+        server.listen(1)
+        print(f"Waiting for a connection on {target}", file=sys.stderr)
+        conn, _ = server.accept()
+        server.close()
+        return conn.sendall, conn
+
+    # Named FIFO, opening blocks until the reader connects
+    f = open(target, "wb")
+    return f.write, f
+
+def replay(fname, target, fs):
+    with open(fname, "rb") as f:
+        data = f.read()
+
+    write, handle = open_output(target)
+    chunk = int(fs * CHUNK_SECONDS / 8)
+    start = time.monotonic()
+    sent = 0
+
+    try:
+        while sent < len(data):
+            write(data[sent:sent + chunk])
+            sent += chunk
+
+            # Hold the sender to the sample rate
+            ahead = sent * 8 / fs - (time.monotonic() - start)
+            if ahead > 0:
+                time.sleep(ahead)
+    except BrokenPipeError:
+        pass
+
+    elapsed = time.monotonic() - start
+    print(f"Sent {min(sent, len(data))} bytes in {elapsed:.3f} s ({min(sent, len(data)) * 8 / elapsed / 1e6:.3f} Msps)", file=sys.stderr)
+
+    if handle is not None:
+        handle.close()
+
+if __name__ == "__main__":
+    target = sys.argv[2] if len(sys.argv) > 2 else "stdout"
+    fs = float(sys.argv[3]) if len(sys.argv) > 3 else 69.984e6
+    replay(sys.argv[1], target, fs)
@@ -5,32 +5,33 @@
 #include <string.h>
 #include "tools.h"
 
-#define FS 69.984e6
-#define FC 9.334875e6
+#define FS DEFAULT_FS
+#define FC DEFAULT_FC
 #define CHIP_RATE 1.023e6
 #define FREQ 1.57542e9
 
 // Perform a fast fourier transform on the CA code
-fftw_complex *transform_code(int tap_idx, int len)
+fftw_complex *transform_code(int tap_idx, int len, double fs)
 {
     // Allocate space for the code sequence
     fftw_complex *code = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * len);
 
-    // NCO and code generator
+    // NCO and code table
     double code_phase = 0.0;
-    double code_rate = CHIP_RATE / FS;
-    CACodeGenerator ca_code(l1_taps[tap_idx][0], l1_taps[tap_idx][1]);
+    double code_rate = CHIP_RATE / fs;
+    const uint32_t *table = l1ca_code_table(tap_idx + 1);
+    int chip = 0;
 
     // Generate the code
     for (int i = 0; i < len; i++)
     {
-        code[i][0] = ca_code.get_chip() ? 1.0 : -1.0;
+        code[i][0] = code_table_chip(table, chip) ? 1.0 : -1.0;
         code[i][1] = 0.0;
 
         code_phase += code_rate;
         if (code_phase >= 1)
         {
-            ca_code.clock_chip();
+            chip = (chip + 1 == CA_CODE_LENGTH) ? 0 : chip + 1;
             code_phase -= 1.0;
         }
     }
@@ -78,8 +79,28 @@ fftw_complex *transform_signal(uint8_t *signal_in, int len)
     return signal;
 }
 
+// Perform a fast fourier transform on baseband I/Q data, the carrier is
+// already removed by the decimator
+fftw_complex *transform_signal_iq(const int8_t *i_in, const int8_t *q_in, int len)
+{
+    fftw_complex *signal = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * len);
+
+    for (int i = 0; i < len; i++)
+    {
+        signal[i][0] = i_in[i];
+        signal[i][1] = q_in[i];
+    }
+
+    // Perform the FFT
+    fftw_plan plan = fftw_plan_dft_1d(len, signal, signal, FFTW_FORWARD, FFTW_ESTIMATE);
+    fftw_execute(plan);
+    fftw_destroy_plan(plan);
+
+    return signal;
+}
+
 // Search for the maximum correlation
-void correlate(fftw_complex *code, fftw_complex *signal, int len, double doppler_range, double *code_phase, double *doppler, double *snr)
+void correlate(fftw_complex *code, fftw_complex *signal, int len, double fs, double doppler_range, double *code_phase, double *doppler, double *snr)
 {
     // Now that we have a frequency domain representation of the signal
     // we can easily find the correct code phase and doppler. The doppler
@@ -97,8 +118,8 @@ void correlate(fftw_complex *code, fftw_complex *signal, int len, double doppler
     double max_snr = 0.0;
 
     // Search for doppler shifts from -doppler_range to +doppler_range
-    // Each bin is len/FS Hz wide
-    for (int dop_shift = int(-1.0 * doppler_range * len / FS); dop_shift <= int(doppler_range * len / FS); dop_shift++)
+    // Each bin is len/fs Hz wide
+    for (int dop_shift = int(-1.0 * doppler_range * len / fs); dop_shift <= int(doppler_range * len / fs); dop_shift++)
     {
         int max_corr_idx = 0;
         double max_corr = 0.0;
@@ -117,7 +138,7 @@ void correlate(fftw_complex *code, fftw_complex *signal, int len, double doppler
 
         // Look through the result for the maximum power point (only 1ms)
         int i;
-        for (i = 0; i < FS / 1000; i++)
+        for (i = 0; i < fs / 1000; i++)
         {
             double power = correlation[i][0] * correlation[i][0] + correlation[i][1] * correlation[i][1];
             if (power > max_corr)
@@ -139,8 +160,8 @@ void correlate(fftw_complex *code, fftw_complex *signal, int len, double doppler
     }
 
     // Return the results
-    *code_phase = (max_snr_idx * 1000.0 / FS) * 1023.0;
-    *doppler = (double)max_snr_dop * FS / len;
+    *code_phase = (max_snr_idx * 1000.0 / fs) * 1023.0;
+    *doppler = (double)max_snr_dop * fs / len;
     *snr = max_snr;
 
     // Clean up
@@ -165,7 +186,7 @@ int acquire_l1ca(int sv, uint8_t *signal_in, int len_ms, int start_ms)
     // Generate FFTs for the code and signal
     int len = int(len_ms * FS / 1000);
     long long start = (long long)((long long)start_ms * FS / 1000);
-    fftw_complex *code = transform_code(sv - 1, len);
+    fftw_complex *code = transform_code(sv - 1, len, FS);
     fftw_complex *signal = transform_signal(signal_in + start, len);
 
     double code_phase = 0.0;
@@ -173,7 +194,49 @@ int acquire_l1ca(int sv, uint8_t *signal_in, int len_ms, int start_ms)
     double snr = 0.0;
 
     // Perform the correlation
-    correlate(code, signal, len, 5000.0, &code_phase, &doppler, &snr);
+    correlate(code, signal, len, FS, 5000.0, &code_phase, &doppler, &snr);
+
+    // Print results
+    printf("PRN %3d, Code phase: %8.1f, Doppler: %8.1f, SNR: %8.1f ", sv, code_phase, doppler, snr);
+    for (int i = 0; i < (int)snr / 10; i++)
+    {
+        printf("*");
+    }
+    printf("\n");
+
+    // Clean up
+    fftw_free(code);
+    fftw_free(signal);
+
+    return 0;
+}
+
+int acquire_l1ca_iq(int sv, const int8_t *i_in, const int8_t *q_in, double fs, int len_ms, int start_ms)
+{
+    if (sv < 1 || sv > 32)
+    {
+        printf("Invalid SV number\n");
+        return 1;
+    }
+
+    if (i_in == nullptr || q_in == nullptr)
+    {
+        printf("Invalid signal\n");
+        return 1;
+    }
+
+    // Generate FFTs for the code and signal
+    int len = int(len_ms * fs / 1000);
+    long long start = (long long)((long long)start_ms * fs / 1000);
+    fftw_complex *code = transform_code(sv - 1, len, fs);
+    fftw_complex *signal = transform_signal_iq(i_in + start, q_in + start, len);
+
+    double code_phase = 0.0;
+    double doppler = 0.0;
+    double snr = 0.0;
+
+    // Perform the correlation
+    correlate(code, signal, len, fs, 5000.0, &code_phase, &doppler, &snr);
 
     // Print results
     printf("PRN %3d, Code phase: %8.1f, Doppler: %8.1f, SNR: %8.1f ", sv, code_phase, doppler, snr);
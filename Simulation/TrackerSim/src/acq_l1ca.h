@@ -5,4 +5,7 @@
 
 int acquire_l1ca(int sv = 1, uint8_t *signal_in = nullptr, int len_ms = 4, int start_ms = 0);
 
+// Baseband I/Q from a Decimator at sample rate fs
+int acquire_l1ca_iq(int sv, const int8_t *i_in, const int8_t *q_in, double fs, int len_ms = 4, int start_ms = 0);
+
 #endif // ACQ_L1CA_H
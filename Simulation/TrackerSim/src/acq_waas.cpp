@@ -5,8 +5,8 @@
 #include <string.h>
 #include "tools.h"
 
-#define FS 69.984e6
-#define FC 9.334875e6
+#define FS DEFAULT_FS
+#define FC DEFAULT_FC
 #define CHIP_RATE 1.023e6
 #define FREQ 1.57542e9
 
@@ -16,21 +16,22 @@ fftw_complex *waas_transform_code(int tap_idx, int len)
     // Allocate space for the code sequence
     fftw_complex *code = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * len);
 
-    // NCO and code generator
+    // NCO and code table
     double code_phase = 0.0;
     double code_rate = CHIP_RATE / FS;
-    WAASCodeGenerator ca_code(waas_code_params[tap_idx][1]);
+    const uint32_t *table = waas_code_table(waas_code_params[tap_idx][0]);
+    int chip = 0;
 
     // Generate the code
     for (int i = 0; i < len; i++)
     {
-        code[i][0] = ca_code.get_chip() ? 1.0 : -1.0;
+        code[i][0] = code_table_chip(table, chip) ? 1.0 : -1.0;
         code[i][1] = 0.0;
 
         code_phase += code_rate;
         if (code_phase >= 1)
         {
-            ca_code.clock_chip();
+            chip = (chip + 1 == CA_CODE_LENGTH) ? 0 : chip + 1;
             code_phase -= 1.0;
         }
     }
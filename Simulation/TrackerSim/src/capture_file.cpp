@@ -0,0 +1,346 @@
+#include "capture_file.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 64-bit file positions for multi-GB captures
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+static_assert(sizeof(CaptureHeader) == CAPTURE_HEADER_SIZE, "Capture header layout changed");
+
+CaptureFile::CaptureFile()
+{
+    map_base = nullptr;
+    map_size = 0;
+    data = nullptr;
+    nbytes = 0;
+    cursor = 0;
+
+    memset(&header, 0, sizeof(header));
+    container = false;
+    index = nullptr;
+
+#ifdef _WIN32
+    file_handle = INVALID_HANDLE_VALUE;
+    map_handle = NULL;
+#else
+    fd = -1;
+#endif
+}
+
+CaptureFile::~CaptureFile()
+{
+    close();
+}
+
+bool CaptureFile::open(const char *filename, capture_packing_t raw_packing)
+{
+    close();
+
+#ifdef _WIN32
+    file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_handle, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    map_size = size.QuadPart;
+
+    map_handle = CreateFileMappingA(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map_handle == NULL)
+    {
+        close();
+        return false;
+    }
+
+    map_base = (const uint8_t *)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+    if (map_base == nullptr)
+    {
+        close();
+        return false;
+    }
+#else
+    fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close();
+        return false;
+    }
+    map_size = st.st_size;
+
+    void *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    map_base = (const uint8_t *)map;
+
+    // Captures are streamed front to back
+    madvise(map, map_size, MADV_SEQUENTIAL);
+#endif
+
+    if (!parse_header(raw_packing))
+    {
+        close();
+        return false;
+    }
+
+    cursor = 0;
+    return true;
+}
+
+bool CaptureFile::parse_header(capture_packing_t raw_packing)
+{
+    container = map_size >= CAPTURE_HEADER_SIZE && memcmp(map_base, CAPTURE_MAGIC, 8) == 0;
+
+    if (!container)
+    {
+        // Raw capture
+        memset(&header, 0, sizeof(header));
+        header.sample_rate = DEFAULT_FS;
+        header.if_freq = DEFAULT_FC;
+        header.bit_depth = (raw_packing == CAPTURE_PACKING_INT8_IQ) ? 8 : ((raw_packing == CAPTURE_PACKING_SIGN_MAG) ? 2 : 1);
+        header.packing = raw_packing;
+        header.nsamples = map_size * 8 / get_bits_per_sample();
+        index = nullptr;
+        data = map_base;
+        nbytes = map_size;
+        return true;
+    }
+
+    memcpy(&header, map_base, sizeof(header));
+
+    // Range checks divide rather than multiply so corrupt fields can't
+    // overflow. A mapping is far below 2^60 bytes, so its size in bits fits.
+    uint64_t size = (uint64_t)map_size;
+    uint64_t bits_per_sample = get_bits_per_sample();
+    if (header.version != CAPTURE_VERSION || header.header_size != CAPTURE_HEADER_SIZE ||
+        header.chunk_samples == 0 || header.index_offset % 8 != 0 ||
+        header.index_offset > size || header.nchunks > (size - header.index_offset) / sizeof(uint64_t) ||
+        header.nchunks < header.nsamples / header.chunk_samples + (header.nsamples % header.chunk_samples != 0) ||
+        header.data_offset > size || header.nsamples > (size - header.data_offset) * 8 / bits_per_sample)
+    {
+        fprintf(stderr, "Invalid capture header\n");
+        return false;
+    }
+
+    index = (const uint64_t *)(map_base + header.index_offset);
+    data = map_base + header.data_offset;
+
+    // The index may follow the data, so stop at the last sample
+    nbytes = (header.nsamples * bits_per_sample + 7) / 8;
+
+    // Every chunk must start in the data, after the one before it, and end
+    // within the data, so sample_to_bit() stays inside [0, nbytes * 8]
+    uint64_t data_end = header.data_offset + nbytes;
+    uint64_t remaining = header.nsamples;
+    for (uint64_t i = 0; i < header.nchunks; i++)
+    {
+        uint64_t chunk = (remaining < header.chunk_samples) ? remaining : header.chunk_samples;
+        remaining -= chunk;
+        if (index[i] < header.data_offset || (i > 0 && index[i] < index[i - 1]) || index[i] > data_end ||
+            (chunk * bits_per_sample + 7) / 8 > data_end - index[i])
+        {
+            fprintf(stderr, "Invalid capture index entry %llu\n", (unsigned long long)i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int CaptureFile::get_bits_per_sample()
+{
+    switch (header.packing)
+    {
+    case CAPTURE_PACKING_SIGN_MAG:
+        return 2;
+    case CAPTURE_PACKING_INT8_IQ:
+        return 16;
+    default:
+        return 1;
+    }
+}
+
+long long CaptureFile::sample_to_bit(long long sample)
+{
+    if (sample <= 0)
+        return 0;
+    if (sample >= get_nsamples())
+        return nbytes * 8;
+
+    if (!container)
+        return sample * get_bits_per_sample();
+
+    // O(1) lookup of the chunk holding the sample
+    long long chunk = sample / header.chunk_samples;
+    long long offset = sample % header.chunk_samples;
+    return (long long)(index[chunk] - header.data_offset) * 8 + offset * get_bits_per_sample();
+}
+
+void CaptureFile::close()
+{
+#ifdef _WIN32
+    if (map_base != nullptr)
+    {
+        UnmapViewOfFile(map_base);
+    }
+    if (map_handle != NULL)
+    {
+        CloseHandle(map_handle);
+        map_handle = NULL;
+    }
+    if (file_handle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file_handle);
+        file_handle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (map_base != nullptr)
+    {
+        munmap((void *)map_base, map_size);
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+
+    map_base = nullptr;
+    map_size = 0;
+    data = nullptr;
+    nbytes = 0;
+    cursor = 0;
+    container = false;
+    index = nullptr;
+}
+
+long long CaptureFile::next_block(const uint64_t **block, long long max_words)
+{
+    // The last word may run past the end of the file. The mapping is page
+    // granular and zero filled, so reading it is safe, but only the first
+    // get_nsamples() samples are valid.
+    long long remaining = get_nwords() - cursor;
+    long long nwords = (remaining < max_words) ? remaining : max_words;
+    if (nwords <= 0)
+    {
+        *block = nullptr;
+        return 0;
+    }
+
+    *block = get_words() + cursor;
+    cursor += nwords;
+    return nwords;
+}
+
+void CaptureFile::seek_word(long long word)
+{
+    if (word < 0)
+        word = 0;
+    if (word > get_nwords())
+        word = get_nwords();
+    cursor = word;
+}
+
+bool CaptureFile::convert_raw(const char *raw_filename, const char *filename,
+                              double sample_rate, double if_freq, double start_time,
+                              int bit_depth, capture_packing_t packing)
+{
+    FILE *in = fopen(raw_filename, "rb");
+    if (in == NULL)
+    {
+        return false;
+    }
+
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL)
+    {
+        fclose(in);
+        return false;
+    }
+
+    // Size of the raw data
+    fseek64(in, 0, SEEK_END);
+    long long raw_size = ftell64(in);
+    fseek64(in, 0, SEEK_SET);
+
+    // Header
+    CaptureHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, 8);
+    header.version = CAPTURE_VERSION;
+    header.header_size = CAPTURE_HEADER_SIZE;
+    header.sample_rate = sample_rate;
+    header.if_freq = if_freq;
+    header.bit_depth = bit_depth;
+    header.packing = packing;
+    header.start_time = start_time;
+
+    int bits_per_sample = (packing == CAPTURE_PACKING_INT8_IQ) ? 16 : ((packing == CAPTURE_PACKING_SIGN_MAG) ? 2 : 1);
+    header.nsamples = raw_size * 8 / bits_per_sample;
+    header.chunk_samples = CAPTURE_CHUNK_SAMPLES;
+    header.nchunks = (header.nsamples + CAPTURE_CHUNK_SAMPLES - 1) / CAPTURE_CHUNK_SAMPLES;
+    header.index_offset = CAPTURE_HEADER_SIZE;
+
+    // Keep the data cache line aligned in the mapping
+    header.data_offset = (header.index_offset + header.nchunks * sizeof(uint64_t) + 63) / 64 * 64;
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    // Chunk index
+    for (uint64_t i = 0; i < header.nchunks && ok; i++)
+    {
+        uint64_t offset = header.data_offset + i * (CAPTURE_CHUNK_SAMPLES * bits_per_sample / 8);
+        ok = fwrite(&offset, sizeof(offset), 1, out) == 1;
+    }
+
+    // Pad to the data
+    for (long long i = ftell64(out); i < (long long)header.data_offset && ok; i++)
+    {
+        ok = fputc(0, out) != EOF;
+    }
+
+    // Copy the samples
+    uint8_t *buf = (uint8_t *)malloc(1 << 20);
+    size_t n;
+    while (ok && (n = fread(buf, 1, 1 << 20, in)) > 0)
+    {
+        ok = fwrite(buf, 1, n, out) == n;
+    }
+    free(buf);
+
+    fclose(in);
+    fclose(out);
+    return ok;
+}
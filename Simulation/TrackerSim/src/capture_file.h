@@ -0,0 +1,104 @@
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "GNSSCAP1"
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEADER_SIZE 128
+#define CAPTURE_CHUNK_SAMPLES (1LL << 20) // Samples per index entry
+
+// Sample layouts a capture can hold
+typedef enum
+{
+    CAPTURE_PACKING_1BIT = 0,      // Real 1-bit samples, first sample in the LSB
+    CAPTURE_PACKING_SIGN_MAG = 1,  // Real 2-bit samples, sign in the low bit and magnitude in the high bit
+    CAPTURE_PACKING_INT8_IQ = 2,   // Interleaved signed 8-bit I and Q
+} capture_packing_t;
+
+// On-disk header of a capture container (little-endian). The chunk index,
+// one uint64_t file offset per CAPTURE_CHUNK_SAMPLES samples, and the
+// sample data are found at the offsets it gives. convert_raw() puts the
+// index first, CaptureWriter appends it after the data.
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    double sample_rate;    // Hz
+    double if_freq;        // Hz
+    uint32_t bit_depth;    // Bits per sample component
+    uint32_t packing;      // capture_packing_t
+    double start_time;     // GPS seconds of the first sample, 0 if unknown
+    uint64_t nsamples;     // Total samples
+    uint64_t chunk_samples;
+    uint64_t nchunks;
+    uint64_t index_offset; // File offset of the chunk index
+    uint64_t data_offset;  // File offset of the first sample
+    uint8_t reserved[40];
+} CaptureHeader;
+
+// Read-only memory mapped view of a capture. Samples are exposed as
+// 64-bit words with the first sample in the least significant bit, which
+// matches the byte order of the raw .bin captures on little-endian
+// machines. Raw captures without a header are assumed to be at the default
+// sample rate and IF, with the packing given to open().
+class CaptureFile
+{
+public:
+    CaptureFile();
+    ~CaptureFile();
+
+    bool open(const char *filename, capture_packing_t raw_packing = CAPTURE_PACKING_1BIT);
+    void close();
+    bool is_open() { return data != nullptr; }
+
+    // Metadata
+    const CaptureHeader *get_header() { return &header; }
+    bool has_container() { return container; }
+    double get_sample_rate() { return header.sample_rate; }
+    double get_if() { return header.if_freq; }
+    double get_start_time() { return header.start_time; }
+    int get_bits_per_sample();
+
+    // Whole capture
+    const uint64_t *get_words() { return (const uint64_t *)data; }
+    long long get_nwords() { return (nbytes + 7) / 8; }
+    long long get_nbytes() { return nbytes; }
+    long long get_nsamples() { return header.nsamples; }
+
+    // Position of a sample in the data, found through the chunk index
+    long long sample_to_bit(long long sample);
+
+    // Cursor API, returns the number of words in the block (0 at the end)
+    long long next_block(const uint64_t **block, long long max_words);
+    void seek_word(long long word);
+    long long tell_word() { return cursor; }
+
+    // Wrap a raw capture in a container with the given metadata
+    static bool convert_raw(const char *raw_filename, const char *filename,
+                            double sample_rate, double if_freq, double start_time,
+                            int bit_depth = 1, capture_packing_t packing = CAPTURE_PACKING_1BIT);
+
+private:
+    const uint8_t *map_base;
+    long long map_size;
+    const uint8_t *data;
+    long long nbytes;
+    long long cursor;
+
+    CaptureHeader header;
+    bool container;
+    const uint64_t *index;
+
+#ifdef _WIN32
+    void *file_handle;
+    void *map_handle;
+#else
+    int fd;
+#endif
+
+    bool parse_header(capture_packing_t raw_packing);
+};
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,253 @@
+#include "capture_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+CaptureWriter::CaptureWriter(long long chunk_size, bool background)
+{
+    this->chunk_size = (chunk_size + 63) / 64 * 64; // Whole words per chunk
+    this->background = background;
+
+    for (int i = 0; i < 2; i++)
+    {
+        buffers[i].words = (uint64_t *)aligned_malloc(this->chunk_size / 8);
+        buffers[i].size = 0;
+    }
+    fill = 0;
+
+    file = NULL;
+    container = false;
+    memset(&header, 0, sizeof(header));
+    nsamples = 0;
+
+    pending = nullptr;
+    stopping = false;
+    failed = false;
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    close();
+
+    for (int i = 0; i < 2; i++)
+    {
+        aligned_free(buffers[i].words);
+    }
+}
+
+bool CaptureWriter::open(const char *filename, bool container,
+                         double sample_rate, double if_freq, double start_time,
+                         capture_packing_t packing)
+{
+    close();
+
+    if (packing != CAPTURE_PACKING_1BIT)
+    {
+        fprintf(stderr, "CaptureWriter only writes 1-bit captures\n");
+        return false;
+    }
+
+    file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    this->container = container;
+    nsamples = 0;
+    fill = 0;
+    buffers[0].size = 0;
+    buffers[1].size = 0;
+    pending = nullptr;
+    stopping = false;
+    failed = false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, 8);
+    header.version = CAPTURE_VERSION;
+    header.header_size = CAPTURE_HEADER_SIZE;
+    header.sample_rate = sample_rate;
+    header.if_freq = if_freq;
+    header.bit_depth = 1;
+    header.packing = CAPTURE_PACKING_1BIT;
+    header.start_time = start_time;
+    header.chunk_samples = CAPTURE_CHUNK_SAMPLES;
+    header.data_offset = CAPTURE_HEADER_SIZE;
+
+    // Placeholder header, completed on close
+    if (container && fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    if (background)
+    {
+        writer = std::thread(&CaptureWriter::writer_loop, this);
+    }
+    return true;
+}
+
+bool CaptureWriter::write_buffer(Buffer *buffer)
+{
+    // Clear bits past the last sample
+    if (buffer->size % 64 != 0)
+    {
+        buffer->words[buffer->size / 64] &= (1ULL << (buffer->size % 64)) - 1;
+    }
+
+    // Whole bytes only, so the final partial byte is kept but nothing past it
+    size_t nbytes = (buffer->size + 7) / 8;
+    return fwrite(buffer->words, 1, nbytes, file) == nbytes;
+}
+
+void CaptureWriter::writer_loop()
+{
+    while (true)
+    {
+        Buffer *buffer;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            queued.wait(guard, [this]
+                        { return pending != nullptr || stopping; });
+            if (pending == nullptr)
+                return;
+            buffer = pending;
+        }
+
+        // Write outside the lock so the producer keeps packing
+        bool ok = write_buffer(buffer);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!ok)
+                failed = true;
+            pending = nullptr;
+        }
+        written.notify_one();
+    }
+}
+
+void CaptureWriter::wait_idle()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    written.wait(guard, [this]
+                 { return pending == nullptr; });
+}
+
+void CaptureWriter::submit()
+{
+    Buffer *buffer = &buffers[fill];
+    if (buffer->size == 0)
+        return;
+
+    if (!background)
+    {
+        if (!write_buffer(buffer))
+            failed = true;
+    }
+    else
+    {
+        // The other buffer must be on disk before it is refilled
+        wait_idle();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending = buffer;
+        }
+        queued.notify_one();
+        fill ^= 1;
+    }
+
+    buffers[fill].size = 0;
+}
+
+void CaptureWriter::write_packed(const uint64_t *words, long long size)
+{
+    long long pos = 0;
+    while (pos < size)
+    {
+        Buffer *buffer = &buffers[fill];
+        long long n = chunk_size - buffer->size;
+        if (n > size - pos)
+            n = size - pos;
+
+        if (buffer->size % 64 == 0 && pos % 64 == 0)
+        {
+            // Word aligned, straight copy
+            memcpy(buffer->words + buffer->size / 64, words + pos / 64, (n + 7) / 8);
+        }
+        else
+        {
+            copy_bits(words, pos, buffer->words, buffer->size, n);
+        }
+        buffer->size += n;
+        pos += n;
+
+        if (buffer->size == chunk_size)
+            submit();
+    }
+    nsamples += size;
+}
+
+void CaptureWriter::write_samples(const uint8_t *samples, long long size)
+{
+    // Pack through a small staging block, then copy into the chunk
+    uint64_t words[64];
+    long long pos = 0;
+    while (pos < size)
+    {
+        long long n = size - pos;
+        if (n > 64 * 64)
+            n = 64 * 64;
+
+        pack_bits(samples + pos, words, n);
+        write_packed(words, n);
+        pos += n;
+    }
+}
+
+bool CaptureWriter::close()
+{
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    // Final partial chunk
+    submit();
+
+    if (background)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        queued.notify_one();
+        writer.join();
+    }
+
+    bool ok = !failed;
+    if (container && ok)
+    {
+        // Chunk index after the data, 8 byte aligned
+        header.nsamples = nsamples;
+        header.nchunks = (nsamples + CAPTURE_CHUNK_SAMPLES - 1) / CAPTURE_CHUNK_SAMPLES;
+        uint64_t data_end = header.data_offset + (nsamples + 7) / 8;
+        header.index_offset = (data_end + 7) / 8 * 8;
+
+        uint64_t zero = 0;
+        ok = fwrite(&zero, 1, header.index_offset - data_end, file) == header.index_offset - data_end;
+        for (uint64_t i = 0; i < header.nchunks && ok; i++)
+        {
+            uint64_t offset = header.data_offset + i * (CAPTURE_CHUNK_SAMPLES / 8);
+            ok = fwrite(&offset, sizeof(offset), 1, file) == 1;
+        }
+
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+    return ok;
+}
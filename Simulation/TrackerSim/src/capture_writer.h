@@ -0,0 +1,73 @@
+#ifndef CAPTURE_WRITER_H
+#define CAPTURE_WRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "capture_file.h"
+#include "tools.h"
+
+// Writes 1-bit samples as a raw .bin capture or as a container readable by
+// CaptureFile. Samples are packed 64 to a word into large chunk buffers
+// which are written whole, optionally from a background thread so packing
+// overlaps with the disk. Containers are written with the data first and
+// the chunk index after it, then the header is filled in on close().
+class CaptureWriter
+{
+public:
+    CaptureWriter(
+        long long chunk_size = 1 << 26, // Samples per write (8 MB packed)
+        bool background = true);
+
+    ~CaptureWriter();
+
+    // Only CAPTURE_PACKING_1BIT can be written, other packings fail
+    bool open(const char *filename, bool container = false,
+              double sample_rate = DEFAULT_FS, double if_freq = DEFAULT_FC, double start_time = 0,
+              capture_packing_t packing = CAPTURE_PACKING_1BIT);
+    // Flushes the final partial word, returns false if any write failed
+    bool close();
+
+    // One sample per byte, samples above 0 are written as 1
+    void write_samples(const uint8_t *samples, long long size);
+    // LSB-first packed samples
+    void write_packed(const uint64_t *words, long long size);
+
+    long long get_nsamples() { return nsamples; }
+
+private:
+    struct Buffer
+    {
+        uint64_t *words;
+        long long size; // Samples
+    };
+
+    FILE *file;
+    bool container;
+    CaptureHeader header;
+    long long chunk_size;
+    long long nsamples;
+
+    // Double buffering, one filling while the other is written
+    Buffer buffers[2];
+    int fill;
+
+    // Background writer, guarded by lock
+    bool background;
+    Buffer *pending;
+    bool stopping;
+    bool failed;
+    std::mutex lock;
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::thread writer;
+
+    void writer_loop();
+    bool write_buffer(Buffer *buffer);
+    void submit();
+    void wait_idle();
+};
+
+#endif // CAPTURE_WRITER_H
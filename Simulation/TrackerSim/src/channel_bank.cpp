@@ -0,0 +1,459 @@
+#include "channel_bank.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define CODE_LENGTH 1023
+#define CHANNEL_BANK_TABLE CA_CODE_WORDS // Chip table words per channel
+
+#ifdef _MSC_VER
+#define CHANNEL_RESTRICT __restrict
+#else
+#define CHANNEL_RESTRICT __restrict__
+#endif
+
+#define SELF_TEST_CHANNELS 9
+#define SELF_TEST_SAMPLES 4096
+
+// The arrays are parameters so the compiler may assume they do not overlap
+#define STEP_PARAMS                                                                                   \
+    const uint8_t *signal, long long size, int n,                                                     \
+        double *CHANNEL_RESTRICT code_ph, const double *CHANNEL_RESTRICT code_step,                   \
+        double *CHANNEL_RESTRICT carrier_ph, const double *CHANNEL_RESTRICT carrier_step,             \
+        int32_t *CHANNEL_RESTRICT chips, const uint32_t *CHANNEL_RESTRICT table,                      \
+        int32_t *CHANNEL_RESTRICT early_chip, int32_t *CHANNEL_RESTRICT prompt_chip,                  \
+        int32_t *CHANNEL_RESTRICT late_chip,                                                          \
+        int32_t *CHANNEL_RESTRICT acc_ie, int32_t *CHANNEL_RESTRICT acc_qe,                           \
+        int32_t *CHANNEL_RESTRICT acc_ip, int32_t *CHANNEL_RESTRICT acc_qp,                           \
+        int32_t *CHANNEL_RESTRICT acc_il, int32_t *CHANNEL_RESTRICT acc_ql
+
+typedef void (*step_channels_t)(STEP_PARAMS);
+
+ChannelBank::ChannelBank(int max_channels)
+{
+    this->max_channels = max_channels;
+    nchannels = 0;
+    trackers = new GPSL1CATracker *[max_channels];
+
+    code_phase = (double *)aligned_malloc(max_channels * sizeof(double));
+    code_rate = (double *)aligned_malloc(max_channels * sizeof(double));
+    carrier_phase = (double *)aligned_malloc(max_channels * sizeof(double));
+    carrier_rate = (double *)aligned_malloc(max_channels * sizeof(double));
+
+    chip = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    chip_table = (uint32_t *)aligned_malloc((size_t)max_channels * CHANNEL_BANK_TABLE * sizeof(uint32_t));
+    code_early = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    code_prompt = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    code_late = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+
+    ie = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    qe = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    ip = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    qp = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    il = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+    ql = (int32_t *)aligned_malloc(max_channels * sizeof(int32_t));
+
+    epoch_processed = new bool[max_channels];
+}
+
+ChannelBank::~ChannelBank()
+{
+    delete[] trackers;
+
+    aligned_free(code_phase);
+    aligned_free(code_rate);
+    aligned_free(carrier_phase);
+    aligned_free(carrier_rate);
+
+    aligned_free(chip);
+    aligned_free(chip_table);
+    aligned_free(code_early);
+    aligned_free(code_prompt);
+    aligned_free(code_late);
+
+    aligned_free(ie);
+    aligned_free(qe);
+    aligned_free(ip);
+    aligned_free(qp);
+    aligned_free(il);
+    aligned_free(ql);
+
+    delete[] epoch_processed;
+}
+
+int ChannelBank::add(GPSL1CATracker *tracker)
+{
+    if (nchannels >= max_channels)
+        return -1;
+
+    int c = nchannels++;
+    trackers[c] = tracker;
+
+    L1CAChannelState state;
+    tracker->get_channel_state(&state);
+    code_phase[c] = state.code_phase;
+    code_rate[c] = state.code_rate;
+    carrier_phase[c] = state.carrier_phase;
+    carrier_rate[c] = state.carrier_rate;
+    chip[c] = state.chip;
+    code_early[c] = state.code_early;
+    code_prompt[c] = state.code_prompt;
+    code_late[c] = state.code_late;
+    epoch_processed[c] = state.epoch_processed;
+
+    // The channel's copy of its code table, bit k is chip k
+    memcpy(chip_table + (size_t)c * CHANNEL_BANK_TABLE, l1ca_code_table(tracker->get_sv()),
+           CA_CODE_WORDS * sizeof(uint32_t));
+
+    ie[c] = 0;
+    qe[c] = 0;
+    ip[c] = 0;
+    qp[c] = 0;
+    il[c] = 0;
+    ql[c] = 0;
+    return c;
+}
+
+// Step n channels over size samples with no epoch checks, as the GPS
+// trackers' TrackerCore::update_sample() and update_code() do. This is the
+// reference the SIMD kernel is checked against.
+static void step_channels_scalar(STEP_PARAMS)
+{
+    for (long long i = 0; i < size; i++)
+    {
+        int32_t s = signal[i];
+        for (int c = 0; c < n; c++)
+        {
+            // Local oscillator, carrier_sin and carrier_cos
+            double phase = carrier_ph[c];
+            int32_t k = (int32_t)phase;
+            int32_t lo_i = k < 2;
+            int32_t lo_q = ((k + 1) & 2) == 0;
+
+            // Carrier NCO
+            double carrier = phase + carrier_step[c];
+            int32_t wrap = carrier >= 4;
+            carrier_ph[c] = carrier - (double)(4 * wrap);
+
+            // Code NCO and chips, clock is all ones when the chip clocks
+            double code = code_ph[c];
+            int32_t clocked = code >= 1;
+            int32_t clock = -clocked;
+            int32_t next = chips[c] + clocked;
+            next = (next == CODE_LENGTH) ? 0 : next;
+            chips[c] = next;
+            int32_t chip_bit = ((int32_t)table[c * CHANNEL_BANK_TABLE + (next >> 5)] >> (next & 31)) & 1;
+            int32_t early = (chip_bit & clock) | (early_chip[c] & ~clock);
+            int32_t late = (prompt_chip[c] & clock) | (late_chip[c] & ~clock);
+            code -= (double)clocked;
+            int32_t prompt = (code >= 0.5) ? early : prompt_chip[c];
+            code_ph[c] = code + code_step[c];
+            early_chip[c] = early;
+            prompt_chip[c] = prompt;
+            late_chip[c] = late;
+
+            // Accumulators, a set XOR counts +1
+            int32_t si = s ^ lo_i;
+            int32_t sq = s ^ lo_q;
+            acc_ie[c] += 2 * (si ^ early) - 1;
+            acc_qe[c] += 2 * (sq ^ early) - 1;
+            acc_ip[c] += 2 * (si ^ prompt) - 1;
+            acc_qp[c] += 2 * (sq ^ prompt) - 1;
+            acc_il[c] += 2 * (si ^ late) - 1;
+            acc_ql[c] += 2 * (sq ^ late) - 1;
+        }
+    }
+}
+
+#ifdef SIMD_X86
+// Compare mask of four doubles narrowed to four 32-bit lanes
+TARGET_AVX2 static inline __m128i narrow_mask(__m256d mask)
+{
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(mask), even));
+}
+
+// Four channels to a vector, NCO phases in double lanes and chips and
+// accumulators in 32-bit lanes. Each group of four stays in registers for
+// the whole span, the chips are read from the tables with a gather. The
+// floating point steps are the scalar ones, so the results are identical.
+TARGET_AVX2 static void step_channels_avx2(STEP_PARAMS)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d four = _mm256_set1_pd(4.0);
+    const __m128i ones = _mm_set1_epi32(1);
+    const __m128i twos = _mm_set1_epi32(2);
+    const __m128i length = _mm_set1_epi32(CODE_LENGTH);
+    const __m128i bit_mask = _mm_set1_epi32(31);
+
+    int c = 0;
+    for (; c + 4 <= n; c += 4)
+    {
+        __m256d code = _mm256_loadu_pd(code_ph + c);
+        __m256d code_rate = _mm256_loadu_pd(code_step + c);
+        __m256d carrier = _mm256_loadu_pd(carrier_ph + c);
+        __m256d carrier_rate = _mm256_loadu_pd(carrier_step + c);
+        __m128i chip = _mm_loadu_si128((const __m128i *)(chips + c));
+        __m128i early = _mm_loadu_si128((const __m128i *)(early_chip + c));
+        __m128i prompt = _mm_loadu_si128((const __m128i *)(prompt_chip + c));
+        __m128i late = _mm_loadu_si128((const __m128i *)(late_chip + c));
+        __m128i ie = _mm_loadu_si128((const __m128i *)(acc_ie + c));
+        __m128i qe = _mm_loadu_si128((const __m128i *)(acc_qe + c));
+        __m128i ip = _mm_loadu_si128((const __m128i *)(acc_ip + c));
+        __m128i qp = _mm_loadu_si128((const __m128i *)(acc_qp + c));
+        __m128i il = _mm_loadu_si128((const __m128i *)(acc_il + c));
+        __m128i ql = _mm_loadu_si128((const __m128i *)(acc_ql + c));
+        const __m128i table_base = _mm_setr_epi32(c * CHANNEL_BANK_TABLE, (c + 1) * CHANNEL_BANK_TABLE,
+                                                  (c + 2) * CHANNEL_BANK_TABLE, (c + 3) * CHANNEL_BANK_TABLE);
+
+        for (long long i = 0; i < size; i++)
+        {
+            __m128i s = _mm_set1_epi32(signal[i]);
+
+            // Local oscillator from the quarter cycle
+            __m128i k = _mm256_cvttpd_epi32(carrier);
+            __m128i lo_i = _mm_and_si128(_mm_cmplt_epi32(k, twos), ones);
+            __m128i lo_q = _mm_andnot_si128(_mm_srli_epi32(_mm_add_epi32(k, ones), 1), ones);
+
+            // Carrier NCO
+            carrier = _mm256_add_pd(carrier, carrier_rate);
+            carrier = _mm256_sub_pd(carrier, _mm256_and_pd(_mm256_cmp_pd(carrier, four, _CMP_GE_OQ), four));
+
+            // Code NCO and chips
+            __m256d clocked = _mm256_cmp_pd(code, one, _CMP_GE_OQ);
+            __m128i clock = narrow_mask(clocked);
+            chip = _mm_sub_epi32(chip, clock);
+            chip = _mm_andnot_si128(_mm_cmpeq_epi32(chip, length), chip);
+            __m128i word = _mm_i32gather_epi32((const int *)table, _mm_add_epi32(table_base, _mm_srli_epi32(chip, 5)), 4);
+            __m128i chip_bit = _mm_and_si128(_mm_srlv_epi32(word, _mm_and_si128(chip, bit_mask)), ones);
+            early = _mm_blendv_epi8(early, chip_bit, clock);
+            __m128i next_late = _mm_blendv_epi8(late, prompt, clock);
+            code = _mm256_sub_pd(code, _mm256_and_pd(clocked, one));
+            prompt = _mm_blendv_epi8(prompt, early, narrow_mask(_mm256_cmp_pd(code, half, _CMP_GE_OQ)));
+            late = next_late;
+            code = _mm256_add_pd(code, code_rate);
+
+            // Accumulators, 2 * (x ^ replica) - 1
+            __m128i si = _mm_xor_si128(s, lo_i);
+            __m128i sq = _mm_xor_si128(s, lo_q);
+            ie = _mm_add_epi32(ie, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(si, early), 1), ones));
+            qe = _mm_add_epi32(qe, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(sq, early), 1), ones));
+            ip = _mm_add_epi32(ip, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(si, prompt), 1), ones));
+            qp = _mm_add_epi32(qp, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(sq, prompt), 1), ones));
+            il = _mm_add_epi32(il, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(si, late), 1), ones));
+            ql = _mm_add_epi32(ql, _mm_sub_epi32(_mm_slli_epi32(_mm_xor_si128(sq, late), 1), ones));
+        }
+
+        _mm256_storeu_pd(code_ph + c, code);
+        _mm256_storeu_pd(carrier_ph + c, carrier);
+        _mm_storeu_si128((__m128i *)(chips + c), chip);
+        _mm_storeu_si128((__m128i *)(early_chip + c), early);
+        _mm_storeu_si128((__m128i *)(prompt_chip + c), prompt);
+        _mm_storeu_si128((__m128i *)(late_chip + c), late);
+        _mm_storeu_si128((__m128i *)(acc_ie + c), ie);
+        _mm_storeu_si128((__m128i *)(acc_qe + c), qe);
+        _mm_storeu_si128((__m128i *)(acc_ip + c), ip);
+        _mm_storeu_si128((__m128i *)(acc_qp + c), qp);
+        _mm_storeu_si128((__m128i *)(acc_il + c), il);
+        _mm_storeu_si128((__m128i *)(acc_ql + c), ql);
+    }
+
+    // Channels left over from the last vector
+    if (c < n)
+    {
+        step_channels_scalar(signal, size, n - c, code_ph + c, code_step + c, carrier_ph + c, carrier_step + c,
+                             chips + c, table + (size_t)c * CHANNEL_BANK_TABLE, early_chip + c, prompt_chip + c,
+                             late_chip + c, acc_ie + c, acc_qe + c, acc_ip + c, acc_qp + c, acc_il + c, acc_ql + c);
+    }
+}
+#endif // SIMD_X86
+
+// Compare a kernel with the scalar one on random channel states, with
+// chips about to wrap and channel counts that leave partial vectors
+static bool self_test(step_channels_t step)
+{
+    static uint8_t signal[SELF_TEST_SAMPLES];
+    static uint32_t table[SELF_TEST_CHANNELS * CHANNEL_BANK_TABLE];
+    double phases[2][4][SELF_TEST_CHANNELS];
+    int32_t state[2][10][SELF_TEST_CHANNELS];
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+
+    for (int round = 0; round < SELF_TEST_CHANNELS; round++)
+    {
+        for (int i = 0; i < SELF_TEST_SAMPLES; i++)
+        {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            signal[i] = (uint8_t)(x >> 63);
+        }
+        for (int i = 0; i < SELF_TEST_CHANNELS * CHANNEL_BANK_TABLE; i++)
+        {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            table[i] = (uint32_t)(x >> 32);
+        }
+        for (int c = 0; c < SELF_TEST_CHANNELS; c++)
+        {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            double u = (double)(x >> 11) / 9007199254740992.0;
+            phases[0][0][c] = u;                           // Code phase
+            phases[0][1][c] = 0.0146 + u * 1e-5;           // Code rate
+            phases[0][2][c] = 4 * u;                       // Carrier phase
+            phases[0][3][c] = 0.5336 + u * 1e-3;           // Carrier rate
+            state[0][0][c] = CODE_LENGTH - 1 - (int)(x >> 60); // Chip
+            for (int k = 1; k < 4; k++)
+            {
+                state[0][k][c] = (int)(x >> (40 + k)) & 1; // Early, prompt, late
+            }
+            for (int k = 4; k < 10; k++)
+            {
+                state[0][k][c] = (int)((x >> (4 * k)) & 0xFFF) - 2048; // Accumulators
+            }
+        }
+        memcpy(phases[1], phases[0], sizeof(phases[0]));
+        memcpy(state[1], state[0], sizeof(state[0]));
+
+        int n = round + 1;
+        step_channels_t steps[2] = {step_channels_scalar, step};
+        for (int t = 0; t < 2; t++)
+        {
+            steps[t](signal, SELF_TEST_SAMPLES, n, phases[t][0], phases[t][1], phases[t][2], phases[t][3],
+                     state[t][0], table, state[t][1], state[t][2], state[t][3],
+                     state[t][4], state[t][5], state[t][6], state[t][7], state[t][8], state[t][9]);
+        }
+        if (memcmp(phases[0], phases[1], sizeof(phases[0])) != 0 || memcmp(state[0], state[1], sizeof(state[0])) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static step_channels_t select_step()
+{
+#ifdef SIMD_X86
+    CpuFeatures cpu;
+    get_cpu_features(&cpu);
+    if (cpu.avx2)
+    {
+        if (self_test(step_channels_avx2))
+            return step_channels_avx2;
+        fprintf(stderr, "AVX2 channel bank failed its self-test, not used\n");
+    }
+#endif
+    return step_channels_scalar;
+}
+
+void ChannelBank::run(const uint8_t *signal, long long size)
+{
+    static const step_channels_t step = select_step();
+    step(signal, size, nchannels, code_phase, code_rate, carrier_phase, carrier_rate,
+         chip, chip_table, code_early, code_prompt, code_late, ie, qe, ip, qp, il, ql);
+}
+
+// Samples every channel can run before one of them may reach its epoch,
+// as in TrackerCore::samples_to_epoch()
+long long ChannelBank::samples_to_epoch()
+{
+    long long span = -1;
+    for (int c = 0; c < nchannels; c++)
+    {
+        if ((chip[c] == 0 && !epoch_processed[c]) || code_rate[c] <= 0)
+            return 0;
+
+        int chips = CODE_LENGTH - chip[c];
+        double samples = floor((chips - code_phase[c]) / code_rate[c]) - 2;
+        long long n = (samples > 0) ? (long long)samples : 0;
+        if (span < 0 || n < span)
+            span = n;
+    }
+    return span;
+}
+
+// After a sample, process the epoch of each channel back on chip 0
+void ChannelBank::poll_epochs()
+{
+    for (int c = 0; c < nchannels; c++)
+    {
+        if (chip[c] != 0)
+        {
+            epoch_processed[c] = false;
+        }
+        else if (!epoch_processed[c])
+        {
+            // The tracker reads the sums and sets new rates
+            int sums[6] = {ie[c], qe[c], ip[c], qp[c], il[c], ql[c]};
+            trackers[c]->process_epoch(sums);
+            code_rate[c] = trackers[c]->get_code_rate();
+            carrier_rate[c] = trackers[c]->get_carrier_rate();
+
+            ie[c] = 0;
+            qe[c] = 0;
+            ip[c] = 0;
+            qp[c] = 0;
+            il[c] = 0;
+            ql[c] = 0;
+            epoch_processed[c] = true;
+        }
+    }
+}
+
+// Hand a channel's state back to its tracker
+void ChannelBank::save(int c)
+{
+    L1CAChannelState state;
+    state.code_phase = code_phase[c];
+    state.code_rate = code_rate[c];
+    state.carrier_phase = carrier_phase[c];
+    state.carrier_rate = carrier_rate[c];
+    state.chip = chip[c];
+    state.code_early = (uint8_t)code_early[c];
+    state.code_prompt = (uint8_t)code_prompt[c];
+    state.code_late = (uint8_t)code_late[c];
+    state.epoch_processed = epoch_processed[c];
+    trackers[c]->set_channel_state(&state);
+}
+
+void ChannelBank::track(const uint8_t *signal, long long size)
+{
+    if (nchannels == 0)
+        return;
+
+    long long i = 0;
+    while (i < size)
+    {
+        // Samples that cannot reach any channel's epoch skip the checks
+        long long span = samples_to_epoch();
+        if (span > size - i)
+        {
+            span = size - i;
+        }
+        run(signal + i, span);
+        i += span;
+        for (int c = 0; c < nchannels; c++)
+        {
+            if (chip[c] != 0)
+            {
+                epoch_processed[c] = false;
+            }
+        }
+
+        // Close to an epoch, check after every sample
+        if (i < size)
+        {
+            run(signal + i, 1);
+            i++;
+            poll_epochs();
+        }
+    }
+
+    for (int c = 0; c < nchannels; c++)
+    {
+        save(c);
+    }
+}
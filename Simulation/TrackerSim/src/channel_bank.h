@@ -0,0 +1,67 @@
+#ifndef CHANNEL_BANK_H
+#define CHANNEL_BANK_H
+
+#include <stdint.h>
+#include "track_l1ca.h"
+
+// Runs the sample-rate half of many GPS L1 C/A channels together. The NCO
+// phases and rates, code chips and accumulators of every channel sit in
+// arrays indexed by channel, with a packed chip table per channel in place
+// of the code generators. Between epochs an AVX2 kernel steps four channels
+// per vector, picked from CPUID after checking it against the scalar loop.
+// The trackers keep the epoch-rate work (loop filters, bit sync,
+// navigation), called at each channel's epoch.
+//
+// The accumulators are identical to tracking each channel on its own with
+// set_bit_sliced(false). A tracker added to a bank must only be tracked
+// through it.
+class ChannelBank
+{
+public:
+    ChannelBank(int max_channels = 64);
+    ~ChannelBank();
+
+    // Take over the tracker's NCOs, returns its channel or -1 when full
+    int add(GPSL1CATracker *tracker);
+    // 1-bit samples, one byte each. The trackers' NCO state is brought up
+    // to date at the end for get_tx_time().
+    void track(const uint8_t *signal, long long size);
+
+    int get_channels() { return nchannels; }
+
+private:
+    int max_channels;
+    int nchannels;
+    GPSL1CATracker **trackers;
+
+    // NCOs
+    double *code_phase;
+    double *code_rate;
+    double *carrier_phase;
+    double *carrier_rate;
+
+    // Code chip and packed chip table of each channel, the table of
+    // channel c starts at word c * CHANNEL_BANK_TABLE
+    int32_t *chip;
+    uint32_t *chip_table;
+    int32_t *code_early;
+    int32_t *code_prompt;
+    int32_t *code_late;
+
+    // Accumulators (early, prompt, late for I and Q)
+    int32_t *ie;
+    int32_t *qe;
+    int32_t *ip;
+    int32_t *qp;
+    int32_t *il;
+    int32_t *ql;
+
+    bool *epoch_processed;
+
+    void run(const uint8_t *signal, long long size);
+    long long samples_to_epoch();
+    void poll_epochs();
+    void save(int c);
+};
+
+#endif // CHANNEL_BANK_H
@@ -0,0 +1,164 @@
+#ifndef CN0_ESTIMATOR_H
+#define CN0_ESTIMATOR_H
+
+#include <math.h>
+#include <stdlib.h>
+
+// C/N0 estimators
+typedef enum
+{
+    CN0_SNV = 0,      // Signal-to-noise variance, as in GNSS-SDR
+    CN0_MM = 1,       // Second and fourth moments (M2M4)
+    CN0_BEAULIEU = 2, // Beaulieu, from the change in |Ip| between epochs
+} cn0_algorithm_t;
+
+// C/N0 over the last Length epochs' prompt sums. update() adds an epoch to
+// running sums in O(1) instead of re-summing the window, so get_cn0() can
+// run every epoch. The |Ip| and Ip^2 + Qp^2 sums are integers and exact.
+// The floating point sums of the other estimators are re-summed once per
+// window to bound rounding drift.
+template <int Length>
+class CN0Estimator
+{
+public:
+    CN0Estimator(double coh_integration_time_s = 0.001, cn0_algorithm_t algorithm = CN0_SNV)
+    {
+        integration_db = 10.0 * log10(coh_integration_time_s);
+        this->algorithm = algorithm;
+        len = 0;
+        idx = 0;
+        sum_abs_ip = 0;
+        sum_power = 0;
+        sum_power_2 = 0;
+        sum_beaulieu = 0;
+        beaulieu_len = 0;
+        last_ip = 0;
+    }
+
+    // Add an epoch's prompt sums, dropping the oldest once the window is full
+    void update(int ip, int qp)
+    {
+        long long power = (long long)ip * ip + (long long)qp * qp;
+        double beaulieu = 0;
+        bool has_beaulieu = len > 0 && (ip != 0 || last_ip != 0);
+        if (has_beaulieu)
+        {
+            // Squared change in |Ip| over its mean square between epochs
+            double d = (double)abs(ip) - abs(last_ip);
+            beaulieu = d * d / (0.5 * ((double)ip * ip + (double)last_ip * last_ip));
+        }
+        if (len == Length)
+        {
+            sum_abs_ip -= abs(ip_buffer[idx]);
+            sum_power -= power_buffer[idx];
+            sum_power_2 -= (double)power_buffer[idx] * power_buffer[idx];
+            sum_beaulieu -= beaulieu_buffer[idx];
+            beaulieu_len -= beaulieu_valid[idx] ? 1 : 0;
+        }
+        else
+        {
+            len++;
+        }
+        ip_buffer[idx] = ip;
+        power_buffer[idx] = power;
+        beaulieu_buffer[idx] = beaulieu;
+        beaulieu_valid[idx] = has_beaulieu;
+        sum_abs_ip += abs(ip);
+        sum_power += power;
+        sum_power_2 += (double)power * power;
+        sum_beaulieu += beaulieu;
+        beaulieu_len += has_beaulieu ? 1 : 0;
+        last_ip = ip;
+        idx = (idx + 1) % Length;
+        if (idx == 0)
+        {
+            resum();
+        }
+    }
+
+    // C/N0 in dB-Hz over the epochs so far, 0 before the first. Until the
+    // window is full the estimate is noisy, a few epochs of noise can read
+    // as a strong signal. CN0_MM gives 0 on weak signals, when the moments
+    // leave no signal or no noise power.
+    double get_cn0()
+    {
+        if (len == 0)
+        {
+            return 0;
+        }
+        double SNR = 0;
+        if (algorithm == CN0_SNV)
+        {
+            double Psig = (double)sum_abs_ip;
+            double Ptot = (double)sum_power;
+            Psig /= static_cast<double>(len);
+            Psig = Psig * Psig;
+            Ptot /= static_cast<double>(len);
+            SNR = Psig / (Ptot - Psig);
+        }
+        else if (algorithm == CN0_MM)
+        {
+            double m2 = (double)sum_power / len;
+            double m4 = sum_power_2 / len;
+            double Psig = 2.0 * m2 * m2 - m4;
+            if (Psig <= 0)
+            {
+                return 0;
+            }
+            Psig = sqrt(Psig);
+            if (m2 - Psig <= 0)
+            {
+                return 0;
+            }
+            SNR = Psig / (m2 - Psig);
+        }
+        else
+        {
+            if (beaulieu_len == 0)
+            {
+                return 0;
+            }
+            SNR = beaulieu_len / sum_beaulieu;
+        }
+        return 10.0 * log10(SNR) - integration_db;
+    }
+
+    // Whether the window holds Length epochs
+    bool full() { return len == Length; }
+
+    void set_algorithm(cn0_algorithm_t algorithm) { this->algorithm = algorithm; }
+    cn0_algorithm_t get_algorithm() { return algorithm; }
+
+private:
+    double integration_db; // Coherent integration time, dB-s
+    cn0_algorithm_t algorithm;
+
+    // Window of the last len epochs, idx is the oldest once full
+    int ip_buffer[Length];
+    long long power_buffer[Length];
+    double beaulieu_buffer[Length];
+    bool beaulieu_valid[Length]; // Epoch has a previous |Ip| to compare with
+    int len;
+    int idx;
+    int last_ip;
+
+    // Running sums over the window
+    long long sum_abs_ip;
+    long long sum_power;
+    double sum_power_2;
+    double sum_beaulieu;
+    int beaulieu_len;
+
+    void resum()
+    {
+        sum_power_2 = 0;
+        sum_beaulieu = 0;
+        for (int i = 0; i < len; i++)
+        {
+            sum_power_2 += (double)power_buffer[i] * power_buffer[i];
+            sum_beaulieu += beaulieu_buffer[i];
+        }
+    }
+};
+
+#endif // CN0_ESTIMATOR_H
@@ -0,0 +1,566 @@
+#include "correlator.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+#define SELF_TEST_ROUNDS 64
+
+static long long correlate_scalar(const uint64_t *signal, const uint64_t *lo_i, const uint64_t *lo_q, const uint64_t *mask,
+                                  const uint64_t *const *replicas, int nreplicas, int nwords, long long *counts)
+{
+    long long total = 0;
+    for (int w = 0; w < nwords; w++)
+    {
+        uint64_t si = signal[w] ^ lo_i[w];
+        uint64_t sq = signal[w] ^ lo_q[w];
+        total += popcount64(mask[w]);
+        for (int r = 0; r < nreplicas; r++)
+        {
+            counts[2 * r] += popcount64((si ^ replicas[r][w]) & mask[w]);
+            counts[2 * r + 1] += popcount64((sq ^ replicas[r][w]) & mask[w]);
+        }
+    }
+    return total;
+}
+
+static void mac_scalar(const int8_t *signal, const int8_t *lo_i, const int8_t *lo_q,
+                       const int8_t *const *replicas, int nreplicas, int n, int *sums)
+{
+    for (int j = 0; j < n; j++)
+    {
+        int wipe_i = signal[j] * lo_i[j];
+        int wipe_q = signal[j] * lo_q[j];
+        for (int r = 0; r < nreplicas; r++)
+        {
+            sums[2 * r] += wipe_i * replicas[r][j];
+            sums[2 * r + 1] += wipe_q * replicas[r][j];
+        }
+    }
+}
+
+#ifdef SIMD_X86
+
+// Bit count of each 64-bit lane from a nibble table
+TARGET_AVX2 static inline __m256i popcount_avx2(__m256i v)
+{
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    return _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+}
+
+TARGET_AVX2 static long long correlate_avx2(const uint64_t *signal, const uint64_t *lo_i, const uint64_t *lo_q, const uint64_t *mask,
+                                            const uint64_t *const *replicas, int nreplicas, int nwords, long long *counts)
+{
+    __m256i acc[2 * CORRELATOR_REPLICAS];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        acc[k] = _mm256_setzero_si256();
+    }
+    __m256i total = _mm256_setzero_si256();
+
+    int w = 0;
+    for (; w + 4 <= nwords; w += 4)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(signal + w));
+        __m256i m = _mm256_loadu_si256((const __m256i *)(mask + w));
+        __m256i si = _mm256_xor_si256(s, _mm256_loadu_si256((const __m256i *)(lo_i + w)));
+        __m256i sq = _mm256_xor_si256(s, _mm256_loadu_si256((const __m256i *)(lo_q + w)));
+        total = _mm256_add_epi64(total, popcount_avx2(m));
+        for (int r = 0; r < nreplicas; r++)
+        {
+            __m256i replica = _mm256_loadu_si256((const __m256i *)(replicas[r] + w));
+            acc[2 * r] = _mm256_add_epi64(acc[2 * r], popcount_avx2(_mm256_and_si256(_mm256_xor_si256(si, replica), m)));
+            acc[2 * r + 1] = _mm256_add_epi64(acc[2 * r + 1], popcount_avx2(_mm256_and_si256(_mm256_xor_si256(sq, replica), m)));
+        }
+    }
+
+    long long lanes[4];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        _mm256_storeu_si256((__m256i *)lanes, acc[k]);
+        counts[k] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    long long n = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    // Words left over from the vectors
+    if (w < nwords)
+    {
+        const uint64_t *tail[CORRELATOR_REPLICAS];
+        for (int r = 0; r < nreplicas; r++)
+        {
+            tail[r] = replicas[r] + w;
+        }
+        n += correlate_scalar(signal + w, lo_i + w, lo_q + w, mask + w, tail, nreplicas, nwords - w, counts);
+    }
+    return n;
+}
+
+TARGET_AVX512BW static inline __m512i popcount_avx512bw(__m512i v)
+{
+    const __m512i table = _mm512_set_epi8(4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0,
+                                          4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0,
+                                          4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0,
+                                          4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0);
+    const __m512i nibble = _mm512_set1_epi8(0x0F);
+    __m512i low = _mm512_shuffle_epi8(table, _mm512_and_si512(v, nibble));
+    __m512i high = _mm512_shuffle_epi8(table, _mm512_and_si512(_mm512_srli_epi16(v, 4), nibble));
+    return _mm512_sad_epu8(_mm512_add_epi8(low, high), _mm512_setzero_si512());
+}
+
+TARGET_AVX512POPCNT static inline __m512i popcount_avx512popcnt(__m512i v)
+{
+    return _mm512_popcnt_epi64(v);
+}
+
+// The two AVX-512 kernels only differ in how they count bits
+#define CORRELATE_AVX512(POPCOUNT)                                                                            \
+    __m512i acc[2 * CORRELATOR_REPLICAS];                                                                     \
+    for (int k = 0; k < 2 * nreplicas; k++)                                                                   \
+    {                                                                                                         \
+        acc[k] = _mm512_setzero_si512();                                                                      \
+    }                                                                                                         \
+    __m512i total = _mm512_setzero_si512();                                                                   \
+                                                                                                              \
+    int w = 0;                                                                                                \
+    for (; w + 8 <= nwords; w += 8)                                                                           \
+    {                                                                                                         \
+        __m512i s = _mm512_loadu_si512((const void *)(signal + w));                                           \
+        __m512i m = _mm512_loadu_si512((const void *)(mask + w));                                             \
+        __m512i si = _mm512_xor_si512(s, _mm512_loadu_si512((const void *)(lo_i + w)));                       \
+        __m512i sq = _mm512_xor_si512(s, _mm512_loadu_si512((const void *)(lo_q + w)));                       \
+        total = _mm512_add_epi64(total, POPCOUNT(m));                                                         \
+        for (int r = 0; r < nreplicas; r++)                                                                   \
+        {                                                                                                     \
+            __m512i replica = _mm512_loadu_si512((const void *)(replicas[r] + w));                            \
+            acc[2 * r] = _mm512_add_epi64(acc[2 * r], POPCOUNT(_mm512_and_si512(_mm512_xor_si512(si, replica), m)));     \
+            acc[2 * r + 1] = _mm512_add_epi64(acc[2 * r + 1], POPCOUNT(_mm512_and_si512(_mm512_xor_si512(sq, replica), m))); \
+        }                                                                                                     \
+    }                                                                                                         \
+                                                                                                              \
+    /* Store and add the lanes, _mm512_reduce_add_epi64 trips -Wuninitialized in GCC */                       \
+    long long lanes[8];                                                                                       \
+    for (int k = 0; k < 2 * nreplicas; k++)                                                                   \
+    {                                                                                                         \
+        _mm512_storeu_si512((void *)lanes, acc[k]);                                                           \
+        for (int l = 0; l < 8; l++)                                                                           \
+        {                                                                                                     \
+            counts[k] += lanes[l];                                                                            \
+        }                                                                                                     \
+    }                                                                                                         \
+    _mm512_storeu_si512((void *)lanes, total);                                                                \
+    long long n = 0;                                                                                          \
+    for (int l = 0; l < 8; l++)                                                                               \
+    {                                                                                                         \
+        n += lanes[l];                                                                                        \
+    }                                                                                                         \
+                                                                                                              \
+    if (w < nwords)                                                                                           \
+    {                                                                                                         \
+        const uint64_t *tail[CORRELATOR_REPLICAS];                                                            \
+        for (int r = 0; r < nreplicas; r++)                                                                   \
+        {                                                                                                     \
+            tail[r] = replicas[r] + w;                                                                        \
+        }                                                                                                     \
+        n += correlate_scalar(signal + w, lo_i + w, lo_q + w, mask + w, tail, nreplicas, nwords - w, counts); \
+    }                                                                                                         \
+    return n;
+
+TARGET_AVX512BW static long long correlate_avx512bw(const uint64_t *signal, const uint64_t *lo_i, const uint64_t *lo_q, const uint64_t *mask,
+                                                    const uint64_t *const *replicas, int nreplicas, int nwords, long long *counts)
+{
+    CORRELATE_AVX512(popcount_avx512bw)
+}
+
+TARGET_AVX512POPCNT static long long correlate_avx512popcnt(const uint64_t *signal, const uint64_t *lo_i, const uint64_t *lo_q, const uint64_t *mask,
+                                                            const uint64_t *const *replicas, int nreplicas, int nwords, long long *counts)
+{
+    CORRELATE_AVX512(popcount_avx512popcnt)
+}
+
+// Carrier wipeoff in 16-bit lanes, then madd multiplies by the replica
+// and adds neighbouring products into 32-bit lanes
+TARGET_AVX2 static void mac_avx2(const int8_t *signal, const int8_t *lo_i, const int8_t *lo_q,
+                                 const int8_t *const *replicas, int nreplicas, int n, int *sums)
+{
+    __m256i acc[2 * CORRELATOR_REPLICAS];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        acc[k] = _mm256_setzero_si256();
+    }
+
+    int j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256i s = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(signal + j)));
+        __m256i wipe_i = _mm256_mullo_epi16(s, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(lo_i + j))));
+        __m256i wipe_q = _mm256_mullo_epi16(s, _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(lo_q + j))));
+        for (int r = 0; r < nreplicas; r++)
+        {
+            __m256i replica = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(replicas[r] + j)));
+            acc[2 * r] = _mm256_add_epi32(acc[2 * r], _mm256_madd_epi16(wipe_i, replica));
+            acc[2 * r + 1] = _mm256_add_epi32(acc[2 * r + 1], _mm256_madd_epi16(wipe_q, replica));
+        }
+    }
+
+    int lanes[8];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        _mm256_storeu_si256((__m256i *)lanes, acc[k]);
+        sums[k] += lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+
+    if (j < n)
+    {
+        const int8_t *tail[CORRELATOR_REPLICAS];
+        for (int r = 0; r < nreplicas; r++)
+        {
+            tail[r] = replicas[r] + j;
+        }
+        mac_scalar(signal + j, lo_i + j, lo_q + j, tail, nreplicas, n - j, sums);
+    }
+}
+
+TARGET_AVX512BW static void mac_avx512bw(const int8_t *signal, const int8_t *lo_i, const int8_t *lo_q,
+                                         const int8_t *const *replicas, int nreplicas, int n, int *sums)
+{
+    __m512i acc[2 * CORRELATOR_REPLICAS];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        acc[k] = _mm512_setzero_si512();
+    }
+
+    int j = 0;
+    for (; j + 32 <= n; j += 32)
+    {
+        __m512i s = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(signal + j)));
+        __m512i wipe_i = _mm512_mullo_epi16(s, _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(lo_i + j))));
+        __m512i wipe_q = _mm512_mullo_epi16(s, _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(lo_q + j))));
+        for (int r = 0; r < nreplicas; r++)
+        {
+            __m512i replica = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(replicas[r] + j)));
+            acc[2 * r] = _mm512_add_epi32(acc[2 * r], _mm512_madd_epi16(wipe_i, replica));
+            acc[2 * r + 1] = _mm512_add_epi32(acc[2 * r + 1], _mm512_madd_epi16(wipe_q, replica));
+        }
+    }
+
+    // Store and add the lanes, as _mm512_reduce_add_epi32 trips -Wuninitialized in GCC
+    int lanes[16];
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        _mm512_storeu_si512((void *)lanes, acc[k]);
+        for (int l = 0; l < 16; l++)
+        {
+            sums[k] += lanes[l];
+        }
+    }
+
+    if (j < n)
+    {
+        const int8_t *tail[CORRELATOR_REPLICAS];
+        for (int r = 0; r < nreplicas; r++)
+        {
+            tail[r] = replicas[r] + j;
+        }
+        mac_scalar(signal + j, lo_i + j, lo_q + j, tail, nreplicas, n - j, sums);
+    }
+}
+
+#endif // SIMD_X86
+
+struct KernelChoice
+{
+    correlator_kernel_t kernel;
+    const char *name;
+};
+
+// Compare a kernel with the scalar one on random words, including the
+// partial vectors at the end of a block
+static bool self_test(correlator_kernel_t kernel)
+{
+    uint64_t words[(4 + CORRELATOR_REPLICAS) * CORRELATOR_WORDS];
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (int round = 0; round < SELF_TEST_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            words[i] = state ^ (state >> 29);
+        }
+        // Mostly whole words, as the trackers queue them
+        for (int w = 0; w < CORRELATOR_WORDS; w += 3)
+        {
+            words[3 * CORRELATOR_WORDS + w] = ~0ULL;
+        }
+
+        const uint64_t *replicas[CORRELATOR_REPLICAS];
+        for (int r = 0; r < CORRELATOR_REPLICAS; r++)
+        {
+            replicas[r] = words + (4 + r) * CORRELATOR_WORDS;
+        }
+        int nreplicas = 1 + round % CORRELATOR_REPLICAS;
+        int nwords = (round * 7) % CORRELATOR_WORDS + 1;
+
+        long long expected[2 * CORRELATOR_REPLICAS] = {0};
+        long long counts[2 * CORRELATOR_REPLICAS] = {0};
+        long long n_expected = correlate_scalar(words, words + CORRELATOR_WORDS, words + 2 * CORRELATOR_WORDS,
+                                                words + 3 * CORRELATOR_WORDS, replicas, nreplicas, nwords, expected);
+        long long n = kernel(words, words + CORRELATOR_WORDS, words + 2 * CORRELATOR_WORDS,
+                             words + 3 * CORRELATOR_WORDS, replicas, nreplicas, nwords, counts);
+        if (n != n_expected || memcmp(counts, expected, sizeof(counts)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The same for a multiply-accumulate kernel, on full-scale int8 values
+static bool mac_self_test(mac_kernel_t kernel)
+{
+    int8_t values[(3 + CORRELATOR_REPLICAS) * MAC_SAMPLES];
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    for (int round = 0; round < SELF_TEST_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < sizeof(values); i++)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            int8_t x = (int8_t)(state >> 56);
+            if (i >= 3 * MAC_SAMPLES)
+            {
+                x = (x < 0) ? -1 : 1;
+            }
+            else if (x == -128)
+            {
+                x = -127;
+            }
+            values[i] = x;
+        }
+
+        const int8_t *replicas[CORRELATOR_REPLICAS];
+        for (int r = 0; r < CORRELATOR_REPLICAS; r++)
+        {
+            replicas[r] = values + (3 + r) * MAC_SAMPLES;
+        }
+        int nreplicas = 1 + round % CORRELATOR_REPLICAS;
+        int n = (round * 97) % MAC_SAMPLES + 1;
+
+        int expected[2 * CORRELATOR_REPLICAS] = {0};
+        int sums[2 * CORRELATOR_REPLICAS] = {0};
+        mac_scalar(values, values + MAC_SAMPLES, values + 2 * MAC_SAMPLES, replicas, nreplicas, n, expected);
+        kernel(values, values + MAC_SAMPLES, values + 2 * MAC_SAMPLES, replicas, nreplicas, n, sums);
+        if (memcmp(sums, expected, sizeof(sums)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static KernelChoice select_kernel()
+{
+    KernelChoice choice;
+    choice.kernel = correlate_scalar;
+    choice.name = "scalar";
+
+#ifdef SIMD_X86
+    CpuFeatures cpu;
+    get_cpu_features(&cpu);
+
+    // Best first
+    KernelChoice candidates[3];
+    bool supported[3] = {cpu.avx512bw && cpu.avx512_popcnt, cpu.avx512bw, cpu.avx2};
+    candidates[0].kernel = correlate_avx512popcnt;
+    candidates[0].name = "AVX-512 VPOPCNTDQ";
+    candidates[1].kernel = correlate_avx512bw;
+    candidates[1].name = "AVX-512BW";
+    candidates[2].kernel = correlate_avx2;
+    candidates[2].name = "AVX2";
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!supported[i])
+            continue;
+        if (self_test(candidates[i].kernel))
+            return candidates[i];
+        fprintf(stderr, "%s correlator failed its self-test, not used\n", candidates[i].name);
+    }
+#endif
+    return choice;
+}
+
+static const KernelChoice &get_choice()
+{
+    static const KernelChoice choice = select_kernel();
+    return choice;
+}
+
+struct MacChoice
+{
+    mac_kernel_t kernel;
+    const char *name;
+};
+
+static MacChoice select_mac()
+{
+    MacChoice choice;
+    choice.kernel = mac_scalar;
+    choice.name = "scalar";
+
+#ifdef SIMD_X86
+    CpuFeatures cpu;
+    get_cpu_features(&cpu);
+
+    MacChoice candidates[2];
+    bool supported[2] = {cpu.avx512bw, cpu.avx2};
+    candidates[0].kernel = mac_avx512bw;
+    candidates[0].name = "AVX-512BW";
+    candidates[1].kernel = mac_avx2;
+    candidates[1].name = "AVX2";
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (!supported[i])
+            continue;
+        if (mac_self_test(candidates[i].kernel))
+            return candidates[i];
+        fprintf(stderr, "%s multiply-accumulate failed its self-test, not used\n", candidates[i].name);
+    }
+#endif
+    return choice;
+}
+
+static const MacChoice &get_mac_choice()
+{
+    static const MacChoice choice = select_mac();
+    return choice;
+}
+
+correlator_kernel_t get_correlator_kernel()
+{
+    return get_choice().kernel;
+}
+
+const char *get_correlator_name()
+{
+    return get_choice().name;
+}
+
+mac_kernel_t get_mac_kernel()
+{
+    return get_mac_choice().kernel;
+}
+
+const char *get_mac_name()
+{
+    return get_mac_choice().name;
+}
+
+CorrelatorBatch::CorrelatorBatch(int nreplicas)
+{
+    this->nreplicas = nreplicas;
+    count = 0;
+
+    signal_words = (uint64_t *)aligned_malloc(CORRELATOR_WORDS * sizeof(uint64_t));
+    lo_i_words = (uint64_t *)aligned_malloc(CORRELATOR_WORDS * sizeof(uint64_t));
+    lo_q_words = (uint64_t *)aligned_malloc(CORRELATOR_WORDS * sizeof(uint64_t));
+    mask_words = (uint64_t *)aligned_malloc(CORRELATOR_WORDS * sizeof(uint64_t));
+    for (int r = 0; r < CORRELATOR_REPLICAS; r++)
+    {
+        replicas[r] = (r < nreplicas) ? (uint64_t *)aligned_malloc(CORRELATOR_WORDS * sizeof(uint64_t)) : NULL;
+    }
+
+    memset(counts, 0, sizeof(counts));
+    nsamples = 0;
+    kernel = get_correlator_kernel();
+}
+
+CorrelatorBatch::~CorrelatorBatch()
+{
+    aligned_free(signal_words);
+    aligned_free(lo_i_words);
+    aligned_free(lo_q_words);
+    aligned_free(mask_words);
+    for (int r = 0; r < nreplicas; r++)
+    {
+        aligned_free(replicas[r]);
+    }
+}
+
+void CorrelatorBatch::run()
+{
+    nsamples += kernel(signal_words, lo_i_words, lo_q_words, mask_words, replicas, nreplicas, count, counts);
+    count = 0;
+}
+
+void CorrelatorBatch::flush(int *sums)
+{
+    if (count > 0)
+    {
+        run();
+    }
+
+    // A set bit counts +1 and a clear one -1
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        sums[k] += (int)(2 * counts[k] - nsamples);
+        counts[k] = 0;
+    }
+    nsamples = 0;
+}
+
+MacBatch::MacBatch(int nreplicas)
+{
+    this->nreplicas = nreplicas;
+    count = 0;
+
+    signal_values = (int8_t *)aligned_malloc(MAC_SAMPLES);
+    lo_i_values = (int8_t *)aligned_malloc(MAC_SAMPLES);
+    lo_q_values = (int8_t *)aligned_malloc(MAC_SAMPLES);
+    for (int r = 0; r < CORRELATOR_REPLICAS; r++)
+    {
+        replicas[r] = (r < nreplicas) ? (int8_t *)aligned_malloc(MAC_SAMPLES) : NULL;
+    }
+
+    memset(pending, 0, sizeof(pending));
+    kernel = get_mac_kernel();
+}
+
+MacBatch::~MacBatch()
+{
+    aligned_free(signal_values);
+    aligned_free(lo_i_values);
+    aligned_free(lo_q_values);
+    for (int r = 0; r < nreplicas; r++)
+    {
+        aligned_free(replicas[r]);
+    }
+}
+
+void MacBatch::run()
+{
+    kernel(signal_values, lo_i_values, lo_q_values, replicas, nreplicas, count, pending);
+    count = 0;
+}
+
+void MacBatch::flush(int *sums)
+{
+    if (count > 0)
+    {
+        run();
+    }
+
+    for (int k = 0; k < 2 * nreplicas; k++)
+    {
+        sums[k] += pending[k];
+        pending[k] = 0;
+    }
+}
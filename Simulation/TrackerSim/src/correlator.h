@@ -0,0 +1,142 @@
+#ifndef CORRELATOR_H
+#define CORRELATOR_H
+
+#include <stdint.h>
+
+#define CORRELATOR_WORDS 64   // Words queued before the kernel runs
+#define CORRELATOR_REPLICAS 6 // Replica words per sample word at most
+#define MAC_SAMPLES 1024      // Multi-bit samples queued before the kernel runs
+
+// Packed correlation kernel. Over nwords words, for each replica r,
+// counts[2 * r] gains popcount((signal ^ lo_i ^ replica_r) & mask) and
+// counts[2 * r + 1] the same with lo_q. Returns the popcount of the masks.
+typedef long long (*correlator_kernel_t)(
+    const uint64_t *signal,
+    const uint64_t *lo_i,
+    const uint64_t *lo_q,
+    const uint64_t *mask,
+    const uint64_t *const *replicas,
+    int nreplicas,
+    int nwords,
+    long long *counts);
+
+// Fastest kernel this CPU runs: scalar, AVX2, AVX-512BW or AVX-512 with
+// VPOPCNTDQ, picked from CPUID on first use. Each SIMD kernel is checked
+// against the scalar kernel on random words first and skipped if it
+// disagrees.
+correlator_kernel_t get_correlator_kernel();
+const char *get_correlator_name();
+
+// Queues the words a tracker correlates and runs the kernel on whole
+// blocks of them. Sums are only complete after flush().
+class CorrelatorBatch
+{
+public:
+    CorrelatorBatch(int nreplicas);
+    ~CorrelatorBatch();
+
+    // Owns its buffers, so it cannot be copied
+    CorrelatorBatch(const CorrelatorBatch &) = delete;
+    CorrelatorBatch &operator=(const CorrelatorBatch &) = delete;
+
+    // One word of samples, set bits of mask are the ones to accumulate
+    void add(uint64_t signal, uint64_t lo_i, uint64_t lo_q, const uint64_t *replica_words, uint64_t mask)
+    {
+        signal_words[count] = signal;
+        lo_i_words[count] = lo_i;
+        lo_q_words[count] = lo_q;
+        mask_words[count] = mask;
+        for (int r = 0; r < nreplicas; r++)
+        {
+            replicas[r][count] = replica_words[r];
+        }
+        count++;
+        if (count == CORRELATOR_WORDS)
+        {
+            run();
+        }
+    }
+
+    // Add the queued +/-1 correlations to sums, in the kernel's order
+    // (replica r with lo_i at 2 * r, with lo_q at 2 * r + 1), and clear them
+    void flush(int *sums);
+
+private:
+    int nreplicas;
+    int count;
+    uint64_t *signal_words;
+    uint64_t *lo_i_words;
+    uint64_t *lo_q_words;
+    uint64_t *mask_words;
+    uint64_t *replicas[CORRELATOR_REPLICAS];
+
+    long long counts[2 * CORRELATOR_REPLICAS];
+    long long nsamples;
+    correlator_kernel_t kernel;
+
+    void run();
+};
+
+// Multi-bit correlation kernel. Over n samples, for each replica r,
+// sums[2 * r] gains the sum of signal * lo_i * replica_r and sums[2 * r + 1]
+// the same with lo_q. Replica values are +1 or -1, the others any int8.
+typedef void (*mac_kernel_t)(
+    const int8_t *signal,
+    const int8_t *lo_i,
+    const int8_t *lo_q,
+    const int8_t *const *replicas,
+    int nreplicas,
+    int n,
+    int *sums);
+
+// Fastest multiply-accumulate kernel: scalar, AVX2 or AVX-512BW, chosen and
+// checked against the scalar kernel as get_correlator_kernel() does
+mac_kernel_t get_mac_kernel();
+const char *get_mac_name();
+
+// Queues multi-bit samples with their carrier and replica values and runs
+// the multiply-accumulate kernel on whole blocks of them
+class MacBatch
+{
+public:
+    MacBatch(int nreplicas);
+    ~MacBatch();
+
+    // Owns its buffers, so it cannot be copied
+    MacBatch(const MacBatch &) = delete;
+    MacBatch &operator=(const MacBatch &) = delete;
+
+    void add(int8_t signal, int8_t lo_i, int8_t lo_q, const int8_t *replica_values)
+    {
+        signal_values[count] = signal;
+        lo_i_values[count] = lo_i;
+        lo_q_values[count] = lo_q;
+        for (int r = 0; r < nreplicas; r++)
+        {
+            replicas[r][count] = replica_values[r];
+        }
+        count++;
+        if (count == MAC_SAMPLES)
+        {
+            run();
+        }
+    }
+
+    // Add the queued correlations to sums, in the kernel's order, and clear them
+    void flush(int *sums);
+
+private:
+    int nreplicas;
+    int count;
+    int8_t *signal_values;
+    int8_t *lo_i_values;
+    int8_t *lo_q_values;
+    int8_t *replicas[CORRELATOR_REPLICAS];
+
+    int pending[2 * CORRELATOR_REPLICAS];
+    mac_kernel_t kernel;
+
+    void run();
+};
+
+#endif // CORRELATOR_H
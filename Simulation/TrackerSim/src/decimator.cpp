@@ -0,0 +1,258 @@
+#include "decimator.h"
+#include "tools.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHIP_RATE 1.023e6
+#define CUTOFF 0.45        // Filter cutoff as a fraction of the output rate
+#define POWER_ALPHA 1e-4   // Smoothing of the output power estimate
+#define GAIN_INTERVAL 1024 // Outputs between quantizer gain updates
+#define LOSS_POINTS 8192   // Frequency grid for the filter loss estimate
+
+// Quantizer step in standard deviations that maximizes the correlation
+// with a Gaussian input, indexed by bits
+static const double quantizer_steps[] = {0, 0, 0.996, 0.586, 0.335};
+
+Decimator::Decimator(double fs, double fc, double samples_per_chip, int bits, int taps_per_phase)
+{
+    this->fs = fs;
+    this->fc = fc;
+
+    factor = (int)floor(fs / (samples_per_chip * CHIP_RATE) + 0.5);
+    if (factor < 1)
+        factor = 1;
+
+    if (bits < 2)
+        bits = 2;
+    if (bits > 4)
+        bits = 4;
+    this->bits = bits;
+    max_level = (1 << bits) - 1;
+    step = quantizer_steps[bits];
+
+    // Windowed sinc low-pass at CUTOFF of the output rate, unity gain at DC
+    ntaps = taps_per_phase * factor;
+    double *taps = new double[ntaps];
+    double cutoff = CUTOFF / factor; // Cycles per input sample
+    double sum = 0;
+    for (int k = 0; k < ntaps; k++)
+    {
+        double t = k - (ntaps - 1) / 2.0;
+        double sinc = (t == 0) ? 2.0 * cutoff : sin(TWO_PI * cutoff * t) / (PI * t);
+        double window = 0.54 - 0.46 * cos(TWO_PI * k / (ntaps - 1)); // Hamming
+        taps[k] = sinc * window;
+        sum += taps[k];
+    }
+    double energy = 0;
+    for (int k = 0; k < ntaps; k++)
+    {
+        taps[k] /= sum;
+        energy += taps[k] * taps[k];
+    }
+
+    // Shift the taps to the IF and fold each group of 8 into a table. Tap k
+    // applies to the input k samples before the newest, which is bit
+    // nwindow - 1 - k of the window.
+    nwindow = (ntaps + 7) / 8 * 8;
+    tables = (float *)aligned_malloc(sizeof(float) * 2 * 256 * (nwindow / 8));
+    double w = TWO_PI * fc / fs;
+    for (int j = 0; j < nwindow / 8; j++)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            double re = 0;
+            double im = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                int k = nwindow - 1 - (8 * j + i);
+                if (k >= ntaps)
+                    continue;
+                double x = ((b >> i) & 0x1) ? 1.0 : -1.0;
+                re += x * taps[k] * cos(w * k);
+                im += x * taps[k] * sin(w * k);
+            }
+            tables[(j * 256 + b) * 2] = (float)re;
+            tables[(j * 256 + b) * 2 + 1] = (float)im;
+        }
+    }
+
+    // Input history, all samples before the first count as 0
+    history = (uint64_t *)calloc((nwindow + 63) / 64, sizeof(uint64_t));
+    buffer = nullptr;
+    buffer_words = 0;
+    phase = 0;
+
+    // Mixer, at the newest input of each output's window
+    for (int k = 0; k < 1024; k++)
+    {
+        lo_cos[k] = (float)cos(TWO_PI * k / 1024.0);
+        lo_sin[k] = (float)sin(TWO_PI * k / 1024.0);
+    }
+    lo_step = (uint32_t)(uint64_t)floor(fmod(fc / fs, 1.0) * 4294967296.0 + 0.5);
+    lo_phase = lo_step * (uint32_t)(factor - 1);
+
+    // A hard-limited input has unit power, half of it in each of I and Q
+    power = 0.5 * energy;
+    scale = (float)(1.0 / (step * sqrt(power)));
+
+    noutputs = 0;
+    nclipped = 0;
+    estimate_losses(taps);
+
+    delete[] taps;
+}
+
+Decimator::~Decimator()
+{
+    aligned_free(tables);
+    aligned_free(buffer);
+    free(history);
+}
+
+int8_t Decimator::quantize(float value)
+{
+    // Offset by half the levels so truncation rounds down
+    int half = (max_level + 1) / 2;
+    float v = value * scale + half;
+    int level;
+    if (v >= 2 * half - 1)
+        level = max_level;
+    else if (v < 1)
+        level = -max_level;
+    else
+        level = 2 * ((int)v - half) + 1;
+
+    if (level == max_level || level == -max_level)
+        nclipped++;
+    return (int8_t)level;
+}
+
+long long Decimator::process(const uint8_t *samples, long long size, int8_t *i_out, int8_t *q_out)
+{
+    const int hist = nwindow - 1;
+    const int nbytes = nwindow / 8;
+    long long total = hist + size;
+
+    // One spare word for the byte reads at the end of the last window
+    long long words = (total + 63) / 64 + 1;
+    if (words > buffer_words)
+    {
+        aligned_free(buffer);
+        buffer = (uint64_t *)aligned_malloc(sizeof(uint64_t) * words);
+        buffer_words = words;
+    }
+    memset(buffer + words - 2, 0, 2 * sizeof(uint64_t));
+
+    // History, then the new samples packed behind it
+    copy_bits(history, 0, buffer, 0, hist);
+    uint64_t staging[64];
+    for (long long pos = 0; pos < size; pos += 64 * 64)
+    {
+        long long n = (size - pos < 64 * 64) ? size - pos : 64 * 64;
+        pack_bits(samples + pos, staging, n);
+        copy_bits(staging, 0, buffer, hist + pos, n);
+    }
+
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    long long n = 0;
+    for (long long end = hist + (factor - phase) - 1; end < total; end += factor)
+    {
+        // Band-pass filter over the window ending at this input, in two
+        // partial sums to shorten the dependency chains
+        long long start = end - hist;
+        const uint8_t *b = bytes + start / 8;
+        int shift = start % 8;
+        float si[2] = {0, 0};
+        float sq[2] = {0, 0};
+        for (int j = 0; j < nbytes; j++)
+        {
+            int byte = ((b[j] | (b[j + 1] << 8)) >> shift) & 0xFF;
+            const float *entry = tables + (j * 256 + byte) * 2;
+            si[j & 1] += entry[0];
+            sq[j & 1] += entry[1];
+        }
+        float bi = si[0] + si[1];
+        float bq = sq[0] + sq[1];
+
+        // Mix the band-pass output down, multiplying by exp(-j w end)
+        int idx = lo_phase >> 22;
+        lo_phase += lo_step * (uint32_t)factor;
+        float yi = bi * lo_cos[idx] + bq * lo_sin[idx];
+        float yq = bq * lo_cos[idx] - bi * lo_sin[idx];
+
+        // Requantize and track the output level. The level changes slowly,
+        // so the gain is only refreshed every GAIN_INTERVAL outputs.
+        power += (0.5 * (yi * yi + yq * yq) - power) * POWER_ALPHA;
+        i_out[n] = quantize(yi);
+        q_out[n] = quantize(yq);
+        n++;
+        if ((noutputs + n) % GAIN_INTERVAL == 0)
+        {
+            scale = (float)(1.0 / (step * sqrt(power)));
+        }
+    }
+
+    // Keep the tail for the next call
+    copy_bits(buffer, total - hist, history, 0, hist);
+    phase = (int)((phase + size) % factor);
+
+    noutputs += n;
+    return n;
+}
+
+void Decimator::estimate_losses(const double *taps)
+{
+    // Band limiting. With a replica matched to the unfiltered code, the
+    // correlator SNR scales with (int S |H|)^2 / (int S * int S_alias |H|^2)
+    // where S is the C/A code spectrum and S_alias is S seen at the
+    // frequency each noise component folds to after decimation.
+    double fs_out = fs / factor;
+    double signal = 0;
+    double total = 0;
+    double noise = 0;
+    for (int k = 0; k < LOSS_POINTS; k++)
+    {
+        double f = fs * ((k + 0.5) / LOSS_POINTS - 0.5);
+
+        // Zero-phase magnitude of the filter
+        double re = 0;
+        double im = 0;
+        for (int t = 0; t < ntaps; t++)
+        {
+            re += taps[t] * cos(TWO_PI * f / fs * t);
+            im -= taps[t] * sin(TWO_PI * f / fs * t);
+        }
+        double h = sqrt(re * re + im * im);
+
+        double x = PI * f / CHIP_RATE;
+        double s = (x == 0) ? 1.0 : (sin(x) / x) * (sin(x) / x);
+
+        double folded = f - fs_out * floor(f / fs_out + 0.5);
+        double xa = PI * folded / CHIP_RATE;
+        double sa = (xa == 0) ? 1.0 : (sin(xa) / xa) * (sin(xa) / xa);
+
+        signal += s * h;
+        total += s;
+        noise += sa * h * h;
+    }
+    filter_loss_db = -10.0 * log10(signal * signal / (total * noise));
+
+    // Requantization of a Gaussian filter output, (E[x q])^2 / (E[q^2] E[x^2])
+    double xq = 0;
+    double qq = 0;
+    const double dx = 1e-3;
+    for (double x = -8.0; x < 8.0; x += dx)
+    {
+        double pdf = exp(-0.5 * x * x) / sqrt(TWO_PI) * dx;
+        int level = 2 * (int)floor(x / step) + 1;
+        if (level > max_level)
+            level = max_level;
+        if (level < -max_level)
+            level = -max_level;
+        xq += x * level * pdf;
+        qq += (double)level * level * pdf;
+    }
+    quantization_loss_db = -10.0 * log10(xq * xq / qq);
+}
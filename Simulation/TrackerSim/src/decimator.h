@@ -0,0 +1,96 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+
+// Front-end stage that mixes real 1-bit IF samples to complex baseband,
+// low-pass filters and decimates them, and requantizes the result to 2-4
+// bit I/Q (odd levels, +-1 ... +-(2^bits - 1)). Trackers and acquisition
+// then run at a few samples per chip with an IF of 0 instead of at the
+// capture rate.
+//
+// The FIR is only evaluated at the output instants (the polyphase form of
+// a decimator). The mixer is moved behind it by shifting the low-pass taps
+// up to the IF, which gives the same output but leaves a filter over the
+// raw 1-bit samples, so 8 taps at a time come from one table lookup.
+//
+// The mixer uses I = x * cos(wt) and Q = -x * sin(wt), so a signal above
+// the IF has a positive baseband frequency.
+class Decimator
+{
+public:
+    Decimator(
+        double fs,
+        double fc,
+        double samples_per_chip = 4.0,
+        int bits = 2,
+        int taps_per_phase = 16);
+
+    ~Decimator();
+
+    // Consume size 1-bit samples, write the decimated I/Q and return the
+    // number of output samples (at most size / get_factor() + 1)
+    long long process(const uint8_t *samples, long long size, int8_t *i_out, int8_t *q_out);
+
+    int get_factor() { return factor; }
+    double get_output_rate() { return fs / factor; }
+    int get_bits() { return bits; }
+
+    // Filter group delay in seconds. Output sample m holds the input from
+    // m * factor / fs - get_delay(), so code phases measured on the raw
+    // samples move back by get_delay() * chip rate.
+    double get_delay() { return ((ntaps - 1) / 2.0 - (factor - 1)) / fs; }
+
+    // Estimated correlator SNR cost of the stage for a 1.023 Mchip/s BPSK
+    // signal, split into band limiting (filter and noise aliasing) and
+    // requantization of the filter output. BOC signals lose more at low
+    // sample rates.
+    double get_filter_loss_db() { return filter_loss_db; }
+    double get_quantization_loss_db() { return quantization_loss_db; }
+    double get_snr_loss_db() { return filter_loss_db + quantization_loss_db; }
+
+    // Fraction of output samples at the largest level
+    double get_clip_fraction() { return noutputs ? (double)nclipped / (2 * noutputs) : 0.0; }
+
+private:
+    double fs;
+    double fc;
+    int factor;
+    int bits;
+    int max_level;
+    double step; // Quantizer step in standard deviations
+
+    // Band-pass filter at the IF as one table per input byte, 256 complex
+    // sums of 8 taps each. The oldest input is in the first table.
+    int ntaps;
+    int nwindow; // ntaps rounded up to whole bytes
+    float *tables;
+
+    // Packed input, the last nwindow - 1 samples of the previous call
+    // (kept in history between calls) followed by the new ones
+    uint64_t *history;
+    uint64_t *buffer;
+    long long buffer_words;
+    int phase; // Inputs since the last output
+
+    // Mixer at the output rate
+    uint32_t lo_phase;
+    uint32_t lo_step;
+    float lo_cos[1024];
+    float lo_sin[1024];
+
+    // Quantizer gain tracking
+    double power;
+    float scale; // 1 / (step * output standard deviation)
+
+    // Statistics
+    long long noutputs;
+    long long nclipped;
+    double filter_loss_db;
+    double quantization_loss_db;
+
+    int8_t quantize(float value);
+    void estimate_losses(const double *taps);
+};
+
+#endif // DECIMATOR_H
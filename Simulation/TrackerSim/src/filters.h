@@ -3,97 +3,116 @@
 
 // Reference: Understanding GPS/GNSS Principles and Applications by Elliott D. Kaplan (3rd Edition)
 
-class PLL
+// Natural frequency of a loop of the given order from its noise bandwidth
+inline double loop_natural_frequency(int order, double noise_bandwidth)
 {
-public:
-    PLL() {}
-    virtual double update(double input) { return 0; }
-    virtual double update(double input, double int_time) { return 0; }
-    virtual double update(double fll_input, double pll_input, double int_time) { return 0; }
-    virtual void set_bandwidth(double noise_bandwidth) {}
-    virtual void set_bandwidth(double noise_bandwidth_fll, double noise_bandwidth_pll) {}
-};
-
-class FirstOrderPLL : public PLL
+    return noise_bandwidth / ((order == 1) ? 0.25 : (order == 2) ? 0.53 : 0.7845);
+}
+
+// Loop filter of order 1 to 3 for a carrier (PLL) or code (DLL) loop.
+// Trackers hold it by value and the order is fixed at compile time, so
+// update() inlines into the epoch code.
+template <int Order>
+class LoopFilter
 {
-public:
-    FirstOrderPLL(double noise_bandwidth);
-
-    double update(double input);
-    void set_bandwidth(double noise_bandwidth);
-
-private:
-    double w_0; // Natural frequency
-};
-
-class SecondOrderPLL : public PLL
-{
-public:
-    SecondOrderPLL(double noise_bandwidth, double acc0 = 0.0);
-
-    double update(double input, double int_time);
-    void set_bandwidth(double noise_bandwidth);
-
-private:
-    double w_0;   // Natural frequency
-    double w_0_2; // Squared natural frequency
-    double a_2;   // Coefficient
-    double acc;   // Accumulator
-};
+    static_assert(Order >= 1 && Order <= 3, "loop filter order is 1 to 3");
 
-class ThirdOrderPLL : public PLL
-{
 public:
-    ThirdOrderPLL(double noise_bandwidth, double acc0 = 0.0);
-
-    double update(double input, double int_time);
-    void set_bandwidth(double noise_bandwidth);
+    LoopFilter(double noise_bandwidth = 0, double acc0 = 0.0)
+    {
+        set_bandwidth(noise_bandwidth);
+        acc1 = (Order == 3) ? 0.0 : acc0;
+        acc2 = (Order == 3) ? acc0 : 0.0;
+    }
+
+    // Filter a discriminator over int_time seconds (unused by the first
+    // order loop)
+    double update(double input, double int_time)
+    {
+        // Update the accumulators and produce the output
+        if (Order == 1)
+        {
+            return w_0 * input;
+        }
+        if (Order == 2)
+        {
+            double new_acc = input * w_0_2 * int_time + acc1;
+            double error = (new_acc + acc1) * 0.5 + (1.414 * w_0 * input);
+            acc1 = new_acc;
+            return error;
+        }
+        double new_acc_1 = input * w_0_3 * int_time + acc1;
+        double new_acc_2 = ((new_acc_1 + acc1) * 0.5 + (1.1 * w_0_2 * input)) * int_time + acc2;
+        double error = (new_acc_2 + acc2) * 0.5 + (2.4 * w_0 * input);
+        acc1 = new_acc_1;
+        acc2 = new_acc_2;
+        return error;
+    }
+
+    void set_bandwidth(double noise_bandwidth)
+    {
+        w_0 = loop_natural_frequency(Order, noise_bandwidth);
+        w_0_2 = w_0 * w_0;
+        w_0_3 = w_0_2 * w_0;
+    }
 
 private:
     double w_0;   // Natural frequency
     double w_0_2; // Squared natural frequency
     double w_0_3; // Cubed natural frequency
-    double a_3;   // Coefficient
-    double b_3;   // Coefficient
-    double acc1;  // First Accumulator
-    double acc2;  // Second Accumulator
+    double acc1;  // First accumulator
+    double acc2;  // Second accumulator (third order)
 };
 
-class ThirdOrderFLLAssistedPLL : public PLL
+// PLL of order 2 or 3 assisted by an FLL one order lower
+template <int Order>
+class FLLAssistedPLL
 {
-public:
-    ThirdOrderFLLAssistedPLL(double noise_bandwidth_fll, double noise_bandwidth_pll, double acc0 = 0.0);
+    static_assert(Order == 2 || Order == 3, "FLL-assisted PLL order is 2 or 3");
 
-    double update(double fll_input, double pll_input, double int_time);
-    void set_bandwidth(double noise_bandwidth_fll, double noise_bandwidth_pll);
-
-private:
-    double w_0p;   // PLL Natural frequency
-    double w_0_2p; // PLL Squared natural frequency
-    double w_0_3p; // PLL Cubed natural frequency
-    double w_0f;   // FLL Natural frequency
-    double w_0_2f; // FLL Squared natural frequency
-    double a_3;    // Coefficient
-    double b_3;    // Coefficient
-    double a_2;    // Coefficient
-    double acc1;   // First Accumulator
-    double acc2;   // Second Accumulator
-};
-
-class SecondOrderFLLAssistedPLL : public PLL
-{
 public:
-    SecondOrderFLLAssistedPLL(double noise_bandwidth_fll, double noise_bandwidth_pll, double acc0 = 0.0);
-
-    double update(double fll_input, double pll_input, double int_time);
-    void set_bandwidth(double noise_bandwidth_fll, double noise_bandwidth_pll);
+    FLLAssistedPLL(double noise_bandwidth_fll = 0, double noise_bandwidth_pll = 0, double acc0 = 0.0)
+    {
+        set_bandwidth(noise_bandwidth_fll, noise_bandwidth_pll);
+        acc1 = (Order == 3) ? 0.0 : acc0;
+        acc2 = (Order == 3) ? acc0 : 0.0;
+    }
+
+    double update(double fll_input, double pll_input, double int_time)
+    {
+        // Update the accumulators and produce the output
+        if (Order == 2)
+        {
+            double new_acc_1 = (((fll_input * w_0f) + (pll_input * w_0_2p)) * int_time) + acc1;
+            double error = (new_acc_1 + acc1) * 0.5 + (1.414 * w_0p * pll_input);
+            acc1 = new_acc_1;
+            return error;
+        }
+        double new_acc_1 = (pll_input * w_0_3p * int_time) + (fll_input * w_0_2f * int_time) + acc1;
+        double new_acc_2 = (((new_acc_1 + acc1) * 0.5 + (1.1 * w_0_2p * pll_input) + (fll_input * 1.414 * w_0f)) * int_time) + acc2;
+        double error = (new_acc_2 + acc2) * 0.5 + (2.4 * w_0p * pll_input);
+        acc1 = new_acc_1;
+        acc2 = new_acc_2;
+        return error;
+    }
+
+    void set_bandwidth(double noise_bandwidth_fll, double noise_bandwidth_pll)
+    {
+        w_0p = loop_natural_frequency(Order, noise_bandwidth_pll);
+        w_0_2p = w_0p * w_0p;
+        w_0_3p = w_0_2p * w_0p;
+        w_0f = loop_natural_frequency(Order - 1, noise_bandwidth_fll);
+        w_0_2f = w_0f * w_0f;
+    }
 
 private:
-    double w_0p;   // PLL Natural frequency
-    double w_0_2p; // PLL Squared natural frequency
-    double w_0f;   // FLL Natural frequency
-    double a_2;    // Coefficient
-    double acc1;   // First Accumulator
+    double w_0p;   // PLL natural frequency
+    double w_0_2p; // PLL squared natural frequency
+    double w_0_3p; // PLL cubed natural frequency
+    double w_0f;   // FLL natural frequency
+    double w_0_2f; // FLL squared natural frequency
+    double acc1;   // First accumulator
+    double acc2;   // Second accumulator (third order)
 };
 
 #endif // FILTERS_H
@@ -0,0 +1,485 @@
+#include "frontend_monitor.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#define DENSITY_BLOCK 4096 // Samples per block for the density extremes
+#define DC_BINS 2          // PSD bins either side of DC left out of the peak search
+
+FrontEndMonitor::FrontEndMonitor(double fs, double fc, bool complex, double summary_interval, int nfft, long long psd_stride)
+{
+    this->fs = fs;
+    this->fc = fc;
+    this->complex = complex;
+    summary_samples = (long long)(summary_interval * fs);
+    total_samples = 0;
+
+    // Real input has a one-sided spectrum
+    this->nfft = nfft;
+    nbins = complex ? nfft : nfft / 2 + 1;
+    this->psd_stride = (psd_stride < nfft) ? nfft : psd_stride;
+    psd_countdown = 0;
+    segment_fill = -1;
+
+    window = new double[nfft];
+    window_power = 0;
+    for (int k = 0; k < nfft; k++)
+    {
+        window[k] = 0.5 - 0.5 * cos(TWO_PI * k / nfft); // Hann
+        window_power += window[k] * window[k];
+    }
+
+    // Planned once and reused for every segment
+    segment = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * nfft);
+    plan = fftw_plan_dft_1d(nfft, segment, segment, FFTW_FORWARD, FFTW_MEASURE);
+
+    psd_sum = new double[nbins];
+    last_psd = new double[nbins];
+    memset(last_psd, 0, sizeof(double) * nbins);
+
+    memset(&summary, 0, sizeof(summary));
+    summary_ready = false;
+    has_magnitude = false;
+    reset_interval();
+}
+
+FrontEndMonitor::~FrontEndMonitor()
+{
+    fftw_destroy_plan(plan);
+    fftw_free(segment);
+    delete[] window;
+    delete[] psd_sum;
+    delete[] last_psd;
+}
+
+void FrontEndMonitor::reset_interval()
+{
+    nsamples = 0;
+    sign_ones = 0;
+    magnitude_ones = 0;
+    sum_i = 0;
+    sum_q = 0;
+    sum_ii = 0;
+    sum_qq = 0;
+    sum_iq = 0;
+
+    block_fill = 0;
+    block_sign = 0;
+    block_magnitude = 0;
+    sign_min = 1;
+    sign_max = 0;
+    magnitude_min = 1;
+    magnitude_max = 0;
+
+    memset(psd_sum, 0, sizeof(double) * nbins);
+    nsegments = 0;
+}
+
+void FrontEndMonitor::end_block()
+{
+    // Complex input counts I and Q in each block
+    double n = complex ? 2.0 * block_fill : (double)block_fill;
+    double sign = block_sign / n;
+    double magnitude = block_magnitude / n;
+    sign_min = std::min(sign_min, sign);
+    sign_max = std::max(sign_max, sign);
+    magnitude_min = std::min(magnitude_min, magnitude);
+    magnitude_max = std::max(magnitude_max, magnitude);
+
+    sign_ones += block_sign;
+    magnitude_ones += block_magnitude;
+    block_fill = 0;
+    block_sign = 0;
+    block_magnitude = 0;
+}
+
+// Find the next run of samples in [*pos, size) that belongs to a PSD
+// segment. Returns its length with *pos at its start, or 0 when the rest of
+// the call falls between segments.
+long long FrontEndMonitor::next_segment(long long size, long long *pos)
+{
+    while (*pos < size)
+    {
+        if (segment_fill < 0)
+        {
+            long long skip = std::min(psd_countdown, size - *pos);
+            psd_countdown -= skip;
+            *pos += skip;
+            if (psd_countdown == 0)
+            {
+                // Segments start psd_stride samples apart
+                segment_fill = 0;
+                psd_countdown = psd_stride;
+            }
+            continue;
+        }
+
+        long long take = std::min((long long)(nfft - segment_fill), size - *pos);
+        psd_countdown -= take;
+        return take;
+    }
+    return 0;
+}
+
+void FrontEndMonitor::add_segment_value(double re, double im)
+{
+    segment[segment_fill][0] = re * window[segment_fill];
+    segment[segment_fill][1] = im * window[segment_fill];
+    segment_fill++;
+    if (segment_fill == nfft)
+    {
+        end_segment();
+    }
+}
+
+void FrontEndMonitor::end_segment()
+{
+    fftw_execute(plan);
+
+    if (complex)
+    {
+        // Negative frequencies first
+        for (int k = 0; k < nfft; k++)
+        {
+            int idx = (k + nfft / 2) % nfft;
+            psd_sum[k] += segment[idx][0] * segment[idx][0] + segment[idx][1] * segment[idx][1];
+        }
+    }
+    else
+    {
+        for (int k = 0; k < nbins; k++)
+        {
+            double power = segment[k][0] * segment[k][0] + segment[k][1] * segment[k][1];
+            psd_sum[k] += (k == 0 || k == nfft / 2) ? power : 2 * power;
+        }
+    }
+
+    nsegments++;
+    segment_fill = -1;
+}
+
+void FrontEndMonitor::process_packed(const uint64_t *sign, const uint64_t *magnitude, long long size)
+{
+    has_magnitude = (magnitude != NULL);
+
+    long long nwords = (size + 63) / 64;
+    for (long long w = 0; w < nwords; w++)
+    {
+        int valid = (size - w * 64 < 64) ? (int)(size - w * 64) : 64;
+        uint64_t mask = (valid == 64) ? ~0ULL : ((1ULL << valid) - 1);
+        int s = popcount64(sign[w] & mask);
+        block_sign += s;
+        block_fill += valid;
+
+        if (magnitude == NULL)
+        {
+            sum_i += 2 * s - valid;
+            sum_ii += valid;
+        }
+        else
+        {
+            // Sum of the levels from the counts of each sign and magnitude
+            int m = popcount64(magnitude[w] & mask);
+            int outer_pos = popcount64(sign[w] & magnitude[w] & mask);
+            int outer_neg = m - outer_pos;
+            int inner_pos = s - outer_pos;
+            int inner_neg = valid - s - outer_neg;
+            block_magnitude += m;
+            sum_i += (inner_pos - inner_neg) + 3 * (outer_pos - outer_neg);
+            sum_ii += (valid - m) + 9 * m;
+        }
+
+        if (block_fill >= DENSITY_BLOCK)
+        {
+            end_block();
+        }
+    }
+
+    // Welch segments
+    long long pos = 0;
+    long long count;
+    while ((count = next_segment(size, &pos)) > 0)
+    {
+        for (long long k = pos; k < pos + count; k++)
+        {
+            double value = ((sign[k / 64] >> (k % 64)) & 0x1) ? 1.0 : -1.0;
+            if (magnitude != NULL && ((magnitude[k / 64] >> (k % 64)) & 0x1))
+            {
+                value *= 3.0;
+            }
+            add_segment_value(value, 0);
+        }
+        pos += count;
+    }
+
+    end_call(size);
+}
+
+void FrontEndMonitor::process_samples(const uint8_t *samples, long long size)
+{
+    // Pack through a small staging block
+    uint64_t words[64];
+    for (long long pos = 0; pos < size; pos += 64 * 64)
+    {
+        long long n = (size - pos < 64 * 64) ? size - pos : 64 * 64;
+        pack_bits(samples + pos, words, n);
+        process_packed(words, NULL, n);
+    }
+}
+
+void FrontEndMonitor::process_values(const int8_t *values, long long size)
+{
+    has_magnitude = true;
+
+    long long pos = 0;
+    while (pos < size)
+    {
+        long long n = std::min(DENSITY_BLOCK - block_fill, size - pos);
+        long long sum = 0;
+        long long sum2 = 0;
+        for (long long k = pos; k < pos + n; k++)
+        {
+            int v = values[k];
+            block_sign += (v > 0);
+            block_magnitude += (v > 1 || v < -1);
+            sum += v;
+            sum2 += v * v;
+        }
+        sum_i += sum;
+        sum_ii += sum2;
+        block_fill += n;
+        pos += n;
+
+        if (block_fill >= DENSITY_BLOCK)
+        {
+            end_block();
+        }
+    }
+
+    pos = 0;
+    long long count;
+    while ((count = next_segment(size, &pos)) > 0)
+    {
+        for (long long k = pos; k < pos + count; k++)
+        {
+            add_segment_value(values[k], 0);
+        }
+        pos += count;
+    }
+
+    end_call(size);
+}
+
+void FrontEndMonitor::process_iq(const int8_t *i_samples, const int8_t *q_samples, long long size)
+{
+    has_magnitude = true;
+
+    long long pos = 0;
+    while (pos < size)
+    {
+        long long n = std::min(DENSITY_BLOCK - block_fill, size - pos);
+        long long si = 0;
+        long long sq = 0;
+        long long sii = 0;
+        long long sqq = 0;
+        long long siq = 0;
+        for (long long k = pos; k < pos + n; k++)
+        {
+            int i = i_samples[k];
+            int q = q_samples[k];
+            block_sign += (i > 0) + (q > 0);
+            block_magnitude += (i > 1 || i < -1) + (q > 1 || q < -1);
+            si += i;
+            sq += q;
+            sii += i * i;
+            sqq += q * q;
+            siq += i * q;
+        }
+        sum_i += si;
+        sum_q += sq;
+        sum_ii += sii;
+        sum_qq += sqq;
+        sum_iq += siq;
+        block_fill += n;
+        pos += n;
+
+        if (block_fill >= DENSITY_BLOCK)
+        {
+            end_block();
+        }
+    }
+
+    pos = 0;
+    long long count;
+    while ((count = next_segment(size, &pos)) > 0)
+    {
+        for (long long k = pos; k < pos + count; k++)
+        {
+            add_segment_value(i_samples[k], q_samples[k]);
+        }
+        pos += count;
+    }
+
+    end_call(size);
+}
+
+// Summaries are published at the end of the call that completes an interval
+void FrontEndMonitor::end_call(long long size)
+{
+    nsamples += size;
+    total_samples += size;
+    if (nsamples >= summary_samples)
+    {
+        end_interval();
+    }
+}
+
+void FrontEndMonitor::end_interval()
+{
+    // Partial block counts toward the totals but not the extremes
+    sign_ones += block_sign;
+    magnitude_ones += block_magnitude;
+    block_fill = 0;
+    block_sign = 0;
+    block_magnitude = 0;
+
+    FrontEndSummary *s = &summary;
+    double n = (double)nsamples;
+    double components = complex ? 2.0 * n : n;
+    s->time = total_samples / fs;
+    s->nsamples = nsamples;
+
+    s->sign_density = sign_ones / components;
+    s->sign_density_min = (sign_min <= sign_max) ? sign_min : s->sign_density;
+    s->sign_density_max = (sign_min <= sign_max) ? sign_max : s->sign_density;
+
+    if (has_magnitude)
+    {
+        s->magnitude_density = magnitude_ones / components;
+        s->magnitude_density_min = (magnitude_min <= magnitude_max) ? magnitude_min : s->magnitude_density;
+        s->magnitude_density_max = (magnitude_min <= magnitude_max) ? magnitude_max : s->magnitude_density;
+        if (s->magnitude_density < AGC_TARGET_DENSITY - AGC_TOLERANCE)
+            s->agc_state = -1;
+        else if (s->magnitude_density > AGC_TARGET_DENSITY + AGC_TOLERANCE)
+            s->agc_state = 1;
+        else
+            s->agc_state = 0;
+    }
+    else
+    {
+        s->magnitude_density = -1;
+        s->magnitude_density_min = -1;
+        s->magnitude_density_max = -1;
+        s->agc_state = 0;
+    }
+
+    s->dc_i = sum_i / n;
+    s->dc_q = complex ? sum_q / n : 0;
+    if (complex)
+    {
+        double var_i = sum_ii / n - s->dc_i * s->dc_i;
+        double var_q = sum_qq / n - s->dc_q * s->dc_q;
+        double cov = sum_iq / n - s->dc_i * s->dc_q;
+        s->gain_imbalance_db = 10.0 * log10(var_q / var_i);
+        s->phase_imbalance_deg = asin(cov / sqrt(var_i * var_q)) * 180.0 / PI;
+    }
+    else
+    {
+        s->gain_imbalance_db = 0;
+        s->phase_imbalance_deg = 0;
+    }
+
+    // Welch average, scaled to power per Hz
+    if (nsegments > 0)
+    {
+        double scale = 1.0 / (nsegments * fs * window_power);
+        for (int k = 0; k < nbins; k++)
+        {
+            last_psd[k] = psd_sum[k] * scale;
+        }
+
+        double *sorted = new double[nbins];
+        memcpy(sorted, last_psd, sizeof(double) * nbins);
+        std::nth_element(sorted, sorted + nbins / 2, sorted + nbins);
+        double median = sorted[nbins / 2];
+        delete[] sorted;
+
+        // Strongest bin away from DC (the IF sits at DC for baseband input)
+        int dc_bin = complex ? nfft / 2 : 0;
+        int peak = -1;
+        for (int k = 0; k < nbins; k++)
+        {
+            if (abs(k - dc_bin) <= DC_BINS)
+                continue;
+            if (peak < 0 || last_psd[k] > last_psd[peak])
+                peak = k;
+        }
+
+        s->noise_floor_db = 10.0 * log10(median);
+        s->peak_db = 10.0 * log10(last_psd[peak] / median);
+        s->peak_freq = complex ? get_psd_freq(peak) : get_psd_freq(peak) - fc;
+    }
+    else
+    {
+        s->noise_floor_db = 0;
+        s->peak_db = 0;
+        s->peak_freq = 0;
+    }
+
+    summary_ready = true;
+    reset_interval();
+}
+
+bool FrontEndMonitor::get_summary(FrontEndSummary *summary)
+{
+    if (!summary_ready)
+    {
+        return false;
+    }
+
+    *summary = this->summary;
+    summary_ready = false;
+    return true;
+}
+
+void FrontEndMonitor::print_summary(const FrontEndSummary *summary)
+{
+    static const char *agc_names[] = {"low", "ok", "high"};
+
+    printf("Front end %.3f s: sign %.2f%% (%.2f-%.2f)", summary->time,
+           summary->sign_density * 100.0, summary->sign_density_min * 100.0, summary->sign_density_max * 100.0);
+    if (summary->magnitude_density >= 0)
+    {
+        printf(", magnitude %.2f%% (%.2f-%.2f) AGC %s",
+               summary->magnitude_density * 100.0, summary->magnitude_density_min * 100.0,
+               summary->magnitude_density_max * 100.0, agc_names[summary->agc_state + 1]);
+    }
+    printf(", DC %.4f", summary->dc_i);
+    if (complex)
+    {
+        printf("/%.4f, IQ %.2f dB %.2f deg", summary->dc_q, summary->gain_imbalance_db, summary->phase_imbalance_deg);
+    }
+    printf(", floor %.1f dB/Hz, peak %.1f dB at %.1f kHz\n",
+           summary->noise_floor_db, summary->peak_db, summary->peak_freq / 1e3);
+}
+
+double FrontEndMonitor::get_psd_freq(int bin)
+{
+    if (complex)
+    {
+        return (bin - nfft / 2) * fs / nfft;
+    }
+    return bin * fs / nfft;
+}
+
+void FrontEndMonitor::get_psd(double *psd_db)
+{
+    for (int k = 0; k < nbins; k++)
+    {
+        psd_db[k] = 10.0 * log10(last_psd[k]);
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef FRONTEND_MONITOR_H
+#define FRONTEND_MONITOR_H
+
+#include <stdint.h>
+#include "fftw3.h"
+
+// Magnitude bit density the MAX2769 AGC settles to
+#define AGC_TARGET_DENSITY 0.33
+#define AGC_TOLERANCE 0.05
+
+// Front-end health over one reporting interval
+struct FrontEndSummary
+{
+    double time;        // Seconds of input at the end of the interval
+    long long nsamples; // Samples in the interval
+
+    // Fraction of positive samples (sign bits set), 0.5 when unbiased. The
+    // minimum and maximum are over blocks of DENSITY_BLOCK samples.
+    double sign_density;
+    double sign_density_min;
+    double sign_density_max;
+
+    // Fraction of samples at the outer level (magnitude bits set), -1 when
+    // the input has no magnitude
+    double magnitude_density;
+    double magnitude_density_min;
+    double magnitude_density_max;
+    int agc_state; // -1 gain low, 0 on target, 1 gain high (from the magnitude density)
+
+    // Mean sample value, and for I/Q input the imbalance of Q against I
+    double dc_i;
+    double dc_q;
+    double gain_imbalance_db;
+    double phase_imbalance_deg;
+
+    // Welch PSD of the interval
+    double noise_floor_db; // Median bin, dB/Hz for unit power input
+    double peak_db;        // Strongest bin away from DC, dB above the median
+    double peak_freq;      // Frequency of the strongest bin, Hz from the IF (or baseband)
+};
+
+// Watches the input samples in the same pass as tracking. Densities come
+// from popcounts of the packed bits; the PSD is a Welch average of short
+// Hann windowed segments, one every psd_stride samples, so the FFT cost
+// stays a small fraction of the input. A summary is published every
+// summary_interval seconds of input.
+class FrontEndMonitor
+{
+public:
+    FrontEndMonitor(
+        double fs,
+        double fc,
+        bool complex = false, // Baseband I/Q input (process_iq) rather than real IF
+        double summary_interval = 1.0,
+        int nfft = 1024,
+        long long psd_stride = 65536);
+
+    ~FrontEndMonitor();
+
+    // LSB-first packed sign bits, and magnitude bits when the front end has them
+    void process_packed(const uint64_t *sign, const uint64_t *magnitude, long long size);
+    // One sample (0 or 1) per byte
+    void process_samples(const uint8_t *samples, long long size);
+    // Multi-level real samples (odd levels, see MultiBitFile::read_values)
+    void process_values(const int8_t *values, long long size);
+    // Multi-level baseband I/Q, e.g. from a Decimator
+    void process_iq(const int8_t *i_samples, const int8_t *q_samples, long long size);
+
+    // Returns true once for each completed interval
+    bool get_summary(FrontEndSummary *summary);
+    void print_summary(const FrontEndSummary *summary);
+
+    // Averaged PSD of the last completed interval, get_psd_size() bins in dB/Hz
+    // from the lowest frequency up
+    int get_psd_size() { return nbins; }
+    double get_psd_freq(int bin);
+    void get_psd(double *psd_db);
+
+private:
+    double fs;
+    double fc;
+    bool complex;
+    long long summary_samples;
+    long long total_samples;
+
+    // Interval accumulators. Densities count I and Q of complex input.
+    long long nsamples;
+    long long sign_ones;
+    long long magnitude_ones;
+    bool has_magnitude;
+    double sum_i;
+    double sum_q;
+    double sum_ii;
+    double sum_qq;
+    double sum_iq;
+
+    // Per block density extremes
+    long long block_fill;
+    long long block_sign;
+    long long block_magnitude;
+    double sign_min;
+    double sign_max;
+    double magnitude_min;
+    double magnitude_max;
+
+    // Welch PSD
+    int nfft;
+    int nbins;
+    long long psd_stride;
+    long long psd_countdown; // Samples until the next segment starts
+    int segment_fill;        // Samples collected of the current segment, -1 when idle
+    double *window;
+    double window_power;
+    fftw_complex *segment; // Transformed in place
+    fftw_plan plan;
+    double *psd_sum;
+    int nsegments;
+    double *last_psd; // Linear, per Hz
+
+    // Completed summary
+    FrontEndSummary summary;
+    bool summary_ready;
+
+    void reset_interval();
+    void end_block();
+    long long next_segment(long long size, long long *pos);
+    void add_segment_value(double re, double im);
+    void end_segment();
+    void end_call(long long size);
+    void end_interval();
+};
+
+#endif // FRONTEND_MONITOR_H
@@ -1,6 +1,16 @@
 #include "stdio.h"
 #include "sig_gen.h"
+#include "prefetch.h"
+#include "capture_writer.h"
+#include "decimator.h"
+#include "frontend_monitor.h"
+#include "sample_bus.h"
+#include "replica_cache.h"
+#include "correlator.h"
+#include "channel_bank.h"
+#include "multi_correlator.h"
 #include "stdlib.h"
+#include "math.h"
 #include "acq_l1ca.h"
 #include "acq_e1c.h"
 #include "track_l1ca.h"
@@ -9,8 +19,35 @@
 #include <windows.h>
 #include "solve.h"
 
-#define FS 69.984e6
-#define FC 9.334875e6
+#define RUN_SECONDS 35
+
+// Track decimated 2-bit I/Q at this many samples per chip, 0 tracks the raw
+// 1-bit samples
+#define DECIMATE_SAMPLES_PER_CHIP 0
+#define DECIMATE_BITS 2
+
+// Share cached code replicas between the GPS trackers, up to this many MB.
+// 0 steps each tracker's code NCO per sample (exact replica timing).
+#define REPLICA_CACHE_MB 0
+
+// Run the GPS trackers on 32-bit integer NCOs, bit-exact with the
+// l1ca_channel RTL
+#define INTEGER_NCO 0
+
+// Step the GPS trackers' NCOs and correlators together in a ChannelBank,
+// exact with tracking them one by one
+#define CHANNEL_BANK 0
+
+// Sample gps0's correlation function at this many code offsets,
+// MULTI_CORRELATOR_SPACING chips apart, and print it every second
+#define MULTI_CORRELATOR_TAPS 0
+#define MULTI_CORRELATOR_SPACING 0.1
+
+// C/N0 estimator of every tracker: CN0_SNV, CN0_MM or CN0_BEAULIEU
+#define CN0_ALGORITHM CN0_SNV
+
+// Code offset measured on the raw samples, moved back by the decimator delay
+double delayed_code(double chips, double code_length, double delay_chips);
 
 void save_signal_data(uint8_t *signal, long long size);
 
@@ -19,17 +56,25 @@ int main(int argc, char *argv[])
     // GalileoE1SigGen sig_gen(FS, FC, -127.25, 0, 10);
     // GPSL1CASigGen sig_gen2(FS, FC, -128.5 + 30, 0, 10);
     // NoiseGen noise_gen(FS, FC, 18e6);
-    SignalFromFile sig_gen;
-    const long long size = (long long)(FS * (long long)35);
+    SignalFromFile sig_file;
 
     // printf("Generating signals...\n");
 
-    if (!sig_gen.open("gnss-20170427-L1.1bit.I.bin"))
+    if (!sig_file.open("gnss-20170427-L1.1bit.I.bin"))
     {
         printf("Error opening file\n");
         return 1;
     }
 
+    // Sample rate and IF come from the capture header (or the defaults for raw captures)
+    const double FS = sig_file.get_sample_rate();
+    const double FC = sig_file.get_if();
+    const long long size = (long long)(FS * (long long)RUN_SECONDS);
+    const long long block_size = (long long)(FS / 1000); // 1 ms of samples
+
+    // Read the capture ahead of the trackers
+    PrefetchSource *sig_gen = new PrefetchSource(&sig_file);
+
     double dll_bw = 5.0;
     double pll_bw = 35.0;
     double fll_bw = 35.0;
@@ -40,23 +85,93 @@ int main(int argc, char *argv[])
         fll_bw = atof(argv[3]);
     }
 
+    // Optional decimating front end, the trackers then run on baseband I/Q
+    Decimator *decimator = NULL;
+    double track_fs = FS;
+    double track_fc = FC;
+    double delay = 0;
+    if (DECIMATE_SAMPLES_PER_CHIP > 0)
+    {
+        decimator = new Decimator(FS, FC, DECIMATE_SAMPLES_PER_CHIP, DECIMATE_BITS);
+        track_fs = decimator->get_output_rate();
+        track_fc = 0;
+        delay = decimator->get_delay() * 1.023e6;
+        printf("Decimating by %d to %.3f MHz, %d bit I/Q, estimated loss %.2f dB\n",
+               decimator->get_factor(), track_fs / 1e6, decimator->get_bits(), decimator->get_snr_loss_db());
+    }
+
+    printf("Correlator: %s, multi-bit %s\n", get_correlator_name(), get_mac_name());
     printf("Tracking GPS...\n");
 
     // Track GPS
-    GPSL1CATracker gps0(2, FS, FC, 1600.0, 7.0);
-    GPSL1CATracker gps1(21, FS, FC, -2400.0, 817.4);
-    GPSL1CATracker gps2(26, FS, FC, -3400, 446.3);
-    GPSL1CATracker gps3(5, FS, FC, 1400.0, 969.4);
+    GPSL1CATracker gps0(2, track_fs, track_fc, 1600.0, delayed_code(7.0, 1023, delay));
+    GPSL1CATracker gps1(21, track_fs, track_fc, -2400.0, delayed_code(817.4, 1023, delay));
+    GPSL1CATracker gps2(26, track_fs, track_fc, -3400, delayed_code(446.3, 1023, delay));
+    GPSL1CATracker gps3(5, track_fs, track_fc, 1400.0, delayed_code(969.4, 1023, delay));
+
+    if (INTEGER_NCO && decimator == NULL)
+    {
+        if (!GPSL1CATracker::check_integer_nco())
+        {
+            fprintf(stderr, "Integer NCOs failed their self-test against the RTL vector\n");
+        }
+        gps0.set_integer_nco(true);
+        gps1.set_integer_nco(true);
+        gps2.set_integer_nco(true);
+        gps3.set_integer_nco(true);
+    }
+
+    ReplicaCache *replica_cache = NULL;
+    if (REPLICA_CACHE_MB > 0 && decimator == NULL)
+    {
+        replica_cache = new ReplicaCache(track_fs, (long long)REPLICA_CACHE_MB << 20);
+        gps0.set_replica_cache(replica_cache);
+        gps1.set_replica_cache(replica_cache);
+        gps2.set_replica_cache(replica_cache);
+        gps3.set_replica_cache(replica_cache);
+    }
+
+    ChannelBank *bank = NULL;
+    if (CHANNEL_BANK && !INTEGER_NCO && replica_cache == NULL && decimator == NULL)
+    {
+        bank = new ChannelBank();
+        bank->add(&gps0);
+        bank->add(&gps1);
+        bank->add(&gps2);
+        bank->add(&gps3);
+    }
+
+    // The taps run on the exact bit-sliced path
+    MultiCorrelator *taps = NULL;
+    int *tap_i = NULL;
+    int *tap_q = NULL;
+    int tap_samples = 0;
+    if (MULTI_CORRELATOR_TAPS > 0 && bank == NULL && !INTEGER_NCO && replica_cache == NULL && decimator == NULL)
+    {
+        gps0.set_taps(MULTI_CORRELATOR_TAPS, MULTI_CORRELATOR_SPACING);
+        taps = gps0.get_taps();
+        tap_i = new int[MULTI_CORRELATOR_TAPS];
+        tap_q = new int[MULTI_CORRELATOR_TAPS];
+    }
 
     printf("Tracking Galileo...\n");
 
     // Track Galileo
-    GalileoE1Tracker gal0(24, FS, FC, -250.0, 2838.0, dll_bw, pll_bw, fll_bw);
-    GalileoE1Tracker gal1(14, FS, FC, -3250.0, 3770.6, dll_bw, pll_bw, fll_bw);
-    GalileoE1Tracker gal2(26, FS, FC, 1000.0, 1001.1, dll_bw, pll_bw, fll_bw);
+    GalileoE1Tracker gal0(24, track_fs, track_fc, -250.0, delayed_code(2838.0, 4092, delay), dll_bw, pll_bw, fll_bw);
+    GalileoE1Tracker gal1(14, track_fs, track_fc, -3250.0, delayed_code(3770.6, 4092, delay), dll_bw, pll_bw, fll_bw);
+    GalileoE1Tracker gal2(26, track_fs, track_fc, 1000.0, delayed_code(1001.1, 4092, delay), dll_bw, pll_bw, fll_bw);
 
     // Track WAAS
-    SBASWAASTracker waas(135, FS, FC, -800, 1004.5);
+    SBASWAASTracker waas(135, track_fs, track_fc, -800, delayed_code(1004.5, 1023, delay));
+
+    gps0.set_cn0_algorithm(CN0_ALGORITHM);
+    gps1.set_cn0_algorithm(CN0_ALGORITHM);
+    gps2.set_cn0_algorithm(CN0_ALGORITHM);
+    gps3.set_cn0_algorithm(CN0_ALGORITHM);
+    gal0.set_cn0_algorithm(CN0_ALGORITHM);
+    gal1.set_cn0_algorithm(CN0_ALGORITHM);
+    gal2.set_cn0_algorithm(CN0_ALGORITHM);
+    waas.set_cn0_algorithm(CN0_ALGORITHM);
 
     // Solver
     Solution solution;
@@ -69,26 +184,88 @@ int main(int argc, char *argv[])
     solver.register_e1_channel(&gal1);
     solver.register_e1_channel(&gal2);
 
+    // Front-end health, summarized every second of input
+    FrontEndMonitor monitor(FS, FC);
+    FrontEndSummary health;
+
+    // Each block is decoded once and shared by the monitor and the trackers
+    SampleBus bus(sig_gen, block_size);
+    int monitoring = bus.subscribe();
+    int tracking = bus.subscribe();
+
+    int8_t *i_samples = NULL;
+    int8_t *q_samples = NULL;
+    if (decimator != NULL)
+    {
+        i_samples = new int8_t[block_size / decimator->get_factor() + 1];
+        q_samples = new int8_t[block_size / decimator->get_factor() + 1];
+    }
+
     // Combine signals
-    for (long long i = 0; i < size; i++)
+    for (long long i = 0; i < size; i += block_size)
     {
         if (i % (long long)FS == 0)
         {
             printf("Time elapsed: %lld s\n", i / (long long)FS);
         }
 
-        // Generate combine and hard-limit
-        double signal = 0;
-        sig_gen.generate(&signal, 1);
-        uint8_t total_signal = (signal /*+ signal2[i] + noise[i]*/) > 0 ? 1 : 0;
-        gal0.track(&total_signal, 1);
-        gal1.track(&total_signal, 1);
-        gal2.track(&total_signal, 1);
-        gps0.track(&total_signal, 1);
-        gps1.track(&total_signal, 1);
-        gps2.track(&total_signal, 1);
-        gps3.track(&total_signal, 1);
-        waas.track(&total_signal, 1);
+        // Read a block of hard-limited samples
+        if (bus.publish() == nullptr)
+        {
+            break;
+        }
+
+        const SampleBlock *block = bus.next(monitoring);
+        monitor.process_packed(block->words, NULL, block->size);
+        bus.release(block);
+        if (monitor.get_summary(&health))
+        {
+            monitor.print_summary(&health);
+        }
+
+        block = bus.next(tracking);
+        const uint8_t *samples = block->samples;
+        long long n = block->size;
+
+        if (decimator != NULL)
+        {
+            long long m = decimator->process(samples, n, i_samples, q_samples);
+            gal0.track_iq(i_samples, q_samples, m);
+            gal1.track_iq(i_samples, q_samples, m);
+            gal2.track_iq(i_samples, q_samples, m);
+            gps0.track_iq(i_samples, q_samples, m);
+            gps1.track_iq(i_samples, q_samples, m);
+            gps2.track_iq(i_samples, q_samples, m);
+            gps3.track_iq(i_samples, q_samples, m);
+            waas.track_iq(i_samples, q_samples, m);
+        }
+        else
+        {
+            gal0.track(samples, n);
+            gal1.track(samples, n);
+            gal2.track(samples, n);
+            if (bank != NULL)
+            {
+                bank->track(samples, n);
+            }
+            else
+            {
+                gps0.track(samples, n);
+                gps1.track(samples, n);
+                gps2.track(samples, n);
+                gps3.track(samples, n);
+            }
+            waas.track(samples, n);
+        }
+        bus.release(block);
+
+        // Keep the latest epoch of the taps
+        if (taps != NULL)
+        {
+            while (taps->read_epoch(tap_i, tap_q, &tap_samples))
+            {
+            }
+        }
         // if (gal0.ready_to_solve())
         // {
         //     double x, y, z;
@@ -104,9 +281,45 @@ int main(int argc, char *argv[])
             {
                 printf("Solution: lat,lon,alt,tbias: %.7f,%.7f,%.2f,%.7f\n", solution.lat, solution.lon, solution.alt, solution.t_bias);
             }
+            if (taps != NULL && tap_samples > 0)
+            {
+                // Magnitude per sample, earliest tap last
+                printf("Correlation PRN %d:", gps0.get_sv());
+                for (int t = 0; t < taps->get_taps(); t++)
+                {
+                    printf(" %.3f", sqrt((double)tap_i[t] * tap_i[t] + (double)tap_q[t] * tap_q[t]) / tap_samples);
+                }
+                printf("\n");
+            }
         }
     }
 
+    delete[] i_samples;
+    delete[] q_samples;
+    delete[] tap_i;
+    delete[] tap_q;
+
+    if (decimator != NULL)
+    {
+        printf("Decimator: %.4f of outputs clipped\n", decimator->get_clip_fraction());
+        delete decimator;
+    }
+
+    delete bank;
+
+    if (replica_cache != NULL)
+    {
+        printf("Replica cache: %lld hits, %lld misses, %.1f MB\n",
+               replica_cache->get_hits(), replica_cache->get_misses(), replica_cache->get_bytes() / 1048576.0);
+        gps0.set_replica_cache(NULL);
+        gps1.set_replica_cache(NULL);
+        gps2.set_replica_cache(NULL);
+        gps3.set_replica_cache(NULL);
+        delete replica_cache;
+    }
+
+    printf("Prefetch: %lld underruns, %.3f s stalled\n", sig_gen->get_underruns(), sig_gen->get_stall_time());
+
     // printf("Acquiring GPS...\n");
 
     // Acquire GPS
@@ -123,29 +336,29 @@ int main(int argc, char *argv[])
     //     acquire_e1c(prn, total_signal, 8, 0);
     // }
 
-    sig_gen.close();
+    delete sig_gen;
+    sig_file.close();
 
     return 0;
 }
 
+double delayed_code(double chips, double code_length, double delay_chips)
+{
+    double shifted = fmod(chips - delay_chips, code_length);
+    return (shifted < 0) ? shifted + code_length : shifted;
+}
+
 void save_signal_data(uint8_t *signal, long long size)
 {
-    FILE *file = fopen("out.bin", "wb");
-    if (file == NULL)
+    CaptureWriter writer;
+    if (!writer.open("out.bin"))
     {
         printf("Error opening file\n");
         return;
     }
-    char byte = 0;
-    for (long long i = 0; i < size; i++)
+    writer.write_samples(signal, size);
+    if (!writer.close())
     {
-        if (i > 0 && i % 8 == 0)
-        {
-            fwrite(&byte, sizeof(char), 1, file);
-            byte = 0;
-        }
-        byte |= (signal[i] > 0) << (i % 8);
+        printf("Error writing file\n");
     }
-
-    fclose(file);
-}
\ No newline at end of file
+}
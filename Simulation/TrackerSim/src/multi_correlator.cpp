@@ -0,0 +1,143 @@
+#include "multi_correlator.h"
+#include "tools.h"
+
+#include <string.h>
+#include <math.h>
+
+MultiCorrelator::MultiCorrelator(const uint8_t *chips, int length, bool boc, int ntaps, double spacing)
+{
+    this->ntaps = ntaps;
+    units_per_chip = boc ? 2 : 1;
+    this->length = length * units_per_chip;
+
+    // A BOC unit is half a chip, the second half inverted
+    table = new uint32_t[(this->length + 31) / 32];
+    memset(table, 0, ((this->length + 31) / 32) * sizeof(uint32_t));
+    for (int k = 0; k < this->length; k++)
+    {
+        uint8_t bit = boc ? (chips[k >> 1] ^ (k & 1)) : chips[k];
+        table[k >> 5] |= (uint32_t)bit << (k & 31);
+    }
+
+    offsets = new double[ntaps];
+    for (int t = 0; t < ntaps; t++)
+    {
+        set_offset(t, (t - (ntaps - 1) / 2.0) * spacing);
+    }
+
+    sum_i = new int[ntaps];
+    sum_q = new int[ntaps];
+    memset(sum_i, 0, ntaps * sizeof(int));
+    memset(sum_q, 0, ntaps * sizeof(int));
+    samples = 0;
+
+    epoch_i = new int[MULTI_CORRELATOR_EPOCHS * ntaps];
+    epoch_q = new int[MULTI_CORRELATOR_EPOCHS * ntaps];
+    head = 0;
+    count = 0;
+    dropped = 0;
+}
+
+MultiCorrelator::~MultiCorrelator()
+{
+    delete[] table;
+    delete[] offsets;
+    delete[] sum_i;
+    delete[] sum_q;
+    delete[] epoch_i;
+    delete[] epoch_q;
+}
+
+void MultiCorrelator::set_offset(int tap, double chips)
+{
+    offsets[tap] = fmod(chips * units_per_chip, (double)length);
+}
+
+// 64 samples of the replica from table position unit, in [0, length),
+// advancing 1 / samples_per_unit units per sample
+uint64_t MultiCorrelator::replica_word(double unit, double samples_per_unit)
+{
+    int k = (int)unit;
+    double edge = k + 1 - unit; // Units to the next edge
+
+    // A tiny negative offset wrapped by adding length can round to length
+    k %= length;
+    uint64_t word = 0;
+    int from = 0;
+    while (from < 64)
+    {
+        // First sample past the edge
+        double next = ceil(edge * samples_per_unit);
+        int to = (next < 64) ? (int)next : 64;
+
+        word = fill_bits(word, (table[k >> 5] >> (k & 31)) & 1, from, to);
+        from = to;
+        k = (k + 1 == length) ? 0 : k + 1;
+        edge += 1;
+    }
+    return word;
+}
+
+void MultiCorrelator::add(uint64_t wiped_i, uint64_t wiped_q, uint64_t mask, double position, double step)
+{
+    if (mask == 0 || step <= 0)
+        return;
+
+    int n = popcount64(mask);
+    double samples_per_unit = 1.0 / (step * units_per_chip);
+    double base = fmod(position * units_per_chip, (double)length);
+    for (int t = 0; t < ntaps; t++)
+    {
+        double unit = base + offsets[t];
+        if (unit < 0)
+        {
+            unit += length;
+        }
+        else if (unit >= length)
+        {
+            unit -= length;
+        }
+
+        // A set XOR counts +1
+        uint64_t replica = replica_word(unit, samples_per_unit);
+        sum_i[t] += 2 * popcount64((wiped_i ^ replica) & mask) - n;
+        sum_q[t] += 2 * popcount64((wiped_q ^ replica) & mask) - n;
+    }
+    samples += n;
+}
+
+void MultiCorrelator::dump()
+{
+    if (samples == 0)
+        return;
+
+    // A full ring drops its oldest epoch
+    if (count == MULTI_CORRELATOR_EPOCHS)
+    {
+        head = (head + 1) % MULTI_CORRELATOR_EPOCHS;
+        count--;
+        dropped++;
+    }
+    int slot = (head + count) % MULTI_CORRELATOR_EPOCHS;
+    memcpy(epoch_i + slot * ntaps, sum_i, ntaps * sizeof(int));
+    memcpy(epoch_q + slot * ntaps, sum_q, ntaps * sizeof(int));
+    epoch_samples[slot] = samples;
+    count++;
+
+    memset(sum_i, 0, ntaps * sizeof(int));
+    memset(sum_q, 0, ntaps * sizeof(int));
+    samples = 0;
+}
+
+bool MultiCorrelator::read_epoch(int *i, int *q, int *samples)
+{
+    if (count == 0)
+        return false;
+
+    memcpy(i, epoch_i + head * ntaps, ntaps * sizeof(int));
+    memcpy(q, epoch_q + head * ntaps, ntaps * sizeof(int));
+    *samples = epoch_samples[head];
+    head = (head + 1) % MULTI_CORRELATOR_EPOCHS;
+    count--;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef MULTI_CORRELATOR_H
+#define MULTI_CORRELATOR_H
+
+#include <stdint.h>
+
+#define MULTI_CORRELATOR_EPOCHS 16 // Epochs kept until read
+
+// Samples the correlation function of a tracked signal at any number of
+// code offsets from the prompt, for multipath and signal quality
+// monitoring. The tracker hands over each packed word once its carrier is
+// wiped off, with the prompt code phase, and every tap builds its replica
+// word from a packed code table in a few runs between chip edges instead
+// of stepping a code NCO per sample. For GPS, taps at -0.5, 0 and 0.5
+// chips repeat the tracker's early, prompt and late correlators, up to the
+// samples on a chip edge. The E1 taps each take the subcarrier at their
+// own offset, where the tracker's E1 early and late use the prompt's.
+class MultiCorrelator
+{
+public:
+    // One code period, a chip per byte. With boc set the replica is BOC(1,1)
+    // as in the Galileo E1 tracker, high for the second half of each chip.
+    // The taps are spacing chips apart, centred on the prompt.
+    MultiCorrelator(const uint8_t *chips, int length, bool boc, int ntaps, double spacing);
+    ~MultiCorrelator();
+
+    // Move a tap to any offset from the prompt, chips (positive is early)
+    void set_offset(int tap, double chips);
+
+    // Correlate the samples in mask of carrier wiped words (signal XOR the
+    // I and Q local oscillators). Bit 0 of the word is at prompt code
+    // phase position chips from chip 0, and the code advances step chips
+    // per sample.
+    void add(uint64_t wiped_i, uint64_t wiped_q, uint64_t mask, double position, double step);
+    // End the epoch, keeping its sums to be read
+    void dump();
+
+    // The oldest unread epoch, false when there is none. Older epochs are
+    // dropped once MULTI_CORRELATOR_EPOCHS are waiting.
+    bool read_epoch(int *i, int *q, int *samples);
+
+    int get_taps() { return ntaps; }
+    double get_offset(int tap) { return offsets[tap] / units_per_chip; }
+    long long get_dropped() { return dropped; }
+
+private:
+    int ntaps;
+    int length;         // Table units in a code period
+    int units_per_chip; // 2 for BOC, half chips
+    uint32_t *table;    // Replica bit of each unit, packed
+
+    double *offsets; // Units
+    int *sum_i;
+    int *sum_q;
+    int samples;
+
+    // Ring of finished epochs
+    int *epoch_i;
+    int *epoch_q;
+    int epoch_samples[MULTI_CORRELATOR_EPOCHS];
+    int head;
+    int count;
+    long long dropped;
+
+    uint64_t replica_word(double unit, double samples_per_unit);
+};
+
+#endif // MULTI_CORRELATOR_H
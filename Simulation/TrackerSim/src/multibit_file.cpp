@@ -0,0 +1,327 @@
+#include "multibit_file.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define ONES_64 0x0101010101010101ULL
+
+// Decode tables for sign/magnitude bytes
+struct SignMagLUT
+{
+    uint64_t level[256];       // Magnitude byte to 8 levels of 1 or 3
+    uint64_t negate[256];      // Sign byte to 0xFF for each negative sample
+    uint32_t interleaved[256]; // Interleaved byte to 4 signed values
+
+    SignMagLUT()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            level[i] = 0;
+            negate[i] = 0;
+            for (int j = 0; j < 8; j++)
+            {
+                level[i] |= (uint64_t)(((i >> j) & 0x1) ? 3 : 1) << (8 * j);
+                negate[i] |= (uint64_t)(((i >> j) & 0x1) ? 0x00 : 0xFF) << (8 * j);
+            }
+
+            interleaved[i] = 0;
+            for (int j = 0; j < 4; j++)
+            {
+                int sign = (i >> (2 * j)) & 0x1;
+                int mag = (i >> (2 * j + 1)) & 0x1;
+                int8_t value = (int8_t)((sign ? 1 : -1) * (mag ? 3 : 1));
+                interleaved[i] |= (uint32_t)(uint8_t)value << (8 * j);
+            }
+        }
+    }
+};
+
+static const SignMagLUT sign_mag_lut;
+
+static inline int8_t sign_mag_value(int sign, int mag)
+{
+    return (int8_t)((sign ? 1 : -1) * (mag ? 3 : 1));
+}
+
+MultiBitFile::MultiBitFile()
+{
+    split = false;
+    packing = CAPTURE_PACKING_SIGN_MAG;
+    nsamples = 0;
+    pos = 0;
+}
+
+MultiBitFile::~MultiBitFile()
+{
+    close();
+}
+
+bool MultiBitFile::open_split(const char *sign_filename, const char *magnitude_filename)
+{
+    close();
+    if (!capture.open(sign_filename) || !magnitude.open(magnitude_filename))
+    {
+        close();
+        return false;
+    }
+
+    if (capture.get_header()->packing != CAPTURE_PACKING_1BIT ||
+        magnitude.get_header()->packing != CAPTURE_PACKING_1BIT)
+    {
+        fprintf(stderr, "Sign and magnitude captures must hold 1-bit samples\n");
+        close();
+        return false;
+    }
+
+    // The recorder can stop one stream slightly before the other
+    nsamples = capture.get_nsamples();
+    if (magnitude.get_nsamples() < nsamples)
+        nsamples = magnitude.get_nsamples();
+
+    split = true;
+    packing = CAPTURE_PACKING_SIGN_MAG;
+    pos = 0;
+    return true;
+}
+
+bool MultiBitFile::open(const char *filename, capture_packing_t packing)
+{
+    close();
+    if (!capture.open(filename, packing))
+    {
+        return false;
+    }
+
+    this->packing = (capture_packing_t)capture.get_header()->packing;
+    if (this->packing != CAPTURE_PACKING_SIGN_MAG && this->packing != CAPTURE_PACKING_INT8_IQ)
+    {
+        fprintf(stderr, "%s does not hold multi-bit samples\n", filename);
+        close();
+        return false;
+    }
+
+    nsamples = capture.get_nsamples();
+    split = false;
+    pos = 0;
+    return true;
+}
+
+void MultiBitFile::close()
+{
+    capture.close();
+    magnitude.close();
+    split = false;
+    nsamples = 0;
+    pos = 0;
+}
+
+bool MultiBitFile::seek(long long sample)
+{
+    if (sample < 0 || sample > nsamples)
+    {
+        return false;
+    }
+    pos = sample;
+    return true;
+}
+
+bool MultiBitFile::seek_time(double seconds)
+{
+    return seek((long long)(seconds * capture.get_sample_rate()));
+}
+
+long long MultiBitFile::read_split(int8_t *samples, long long size)
+{
+    const uint8_t *sign = (const uint8_t *)capture.get_words();
+    const uint8_t *mag = (const uint8_t *)magnitude.get_words();
+
+    // Chunks hold a multiple of 8 samples, so both streams share the bit offset
+    long long sbit = capture.sample_to_bit(pos);
+    long long mbit = magnitude.sample_to_bit(pos);
+    long long i = 0;
+
+    // Bit by bit up to a byte boundary
+    while (i < size && (sbit + i) % 8 != 0)
+    {
+        samples[i] = sign_mag_value((sign[(sbit + i) / 8] >> ((sbit + i) % 8)) & 0x1,
+                                    (mag[(mbit + i) / 8] >> ((mbit + i) % 8)) & 0x1);
+        i++;
+    }
+
+    // 8 samples per byte pair. The level is negated in each byte lane with
+    // (level ^ 0xFF) + 1, which can never carry into the next lane.
+    const uint8_t *sb = sign + (sbit + i) / 8;
+    const uint8_t *mb = mag + (mbit + i) / 8;
+    long long whole = (size - i) / 8;
+    for (long long k = 0; k < whole; k++)
+    {
+        uint64_t neg = sign_mag_lut.negate[sb[k]];
+        uint64_t values = (sign_mag_lut.level[mb[k]] ^ neg) + (neg & ONES_64);
+        memcpy(samples + i + k * 8, &values, 8);
+    }
+    i += whole * 8;
+
+    // Remaining bits
+    while (i < size)
+    {
+        samples[i] = sign_mag_value((sign[(sbit + i) / 8] >> ((sbit + i) % 8)) & 0x1,
+                                    (mag[(mbit + i) / 8] >> ((mbit + i) % 8)) & 0x1);
+        i++;
+    }
+
+    return size;
+}
+
+long long MultiBitFile::read_interleaved(int8_t *samples, long long size)
+{
+    const uint8_t *bytes = (const uint8_t *)capture.get_words();
+    long long bit = capture.sample_to_bit(pos);
+    long long i = 0;
+
+    // Sample by sample up to a byte boundary
+    while (i < size && (bit + 2 * i) % 8 != 0)
+    {
+        int pair = bytes[(bit + 2 * i) / 8] >> ((bit + 2 * i) % 8);
+        samples[i++] = sign_mag_value(pair & 0x1, (pair >> 1) & 0x1);
+    }
+
+    // 4 samples per byte through the lookup table
+    const uint8_t *b = bytes + (bit + 2 * i) / 8;
+    long long whole = (size - i) / 4;
+    for (long long k = 0; k < whole; k++)
+    {
+        memcpy(samples + i + k * 4, &sign_mag_lut.interleaved[b[k]], 4);
+    }
+    i += whole * 4;
+
+    // Remaining samples
+    while (i < size)
+    {
+        int pair = bytes[(bit + 2 * i) / 8] >> ((bit + 2 * i) % 8);
+        samples[i++] = sign_mag_value(pair & 0x1, (pair >> 1) & 0x1);
+    }
+
+    return size;
+}
+
+long long MultiBitFile::read_values(int8_t *samples, long long size)
+{
+    if (size > nsamples - pos)
+        size = nsamples - pos;
+    if (size <= 0)
+        return 0;
+
+    if (split)
+    {
+        read_split(samples, size);
+    }
+    else if (packing == CAPTURE_PACKING_SIGN_MAG)
+    {
+        read_interleaved(samples, size);
+    }
+    else
+    {
+        const int8_t *iq = (const int8_t *)capture.get_words() + capture.sample_to_bit(pos) / 8;
+        for (long long k = 0; k < size; k++)
+        {
+            samples[k] = iq[2 * k];
+        }
+    }
+
+    pos += size;
+    return size;
+}
+
+long long MultiBitFile::read_iq(int8_t *i, int8_t *q, long long size)
+{
+    if (packing != CAPTURE_PACKING_INT8_IQ)
+    {
+        size = read_values(i, size);
+        memset(q, 0, size);
+        return size;
+    }
+
+    if (size > nsamples - pos)
+        size = nsamples - pos;
+    if (size <= 0)
+        return 0;
+
+    const int8_t *iq = (const int8_t *)capture.get_words() + capture.sample_to_bit(pos) / 8;
+    for (long long k = 0; k < size; k++)
+    {
+        i[k] = iq[2 * k];
+        q[k] = iq[2 * k + 1];
+    }
+
+    pos += size;
+    return size;
+}
+
+long long MultiBitFile::read_samples(uint8_t *samples, long long size)
+{
+    if (size > nsamples - pos)
+        size = nsamples - pos;
+    if (size <= 0)
+        return 0;
+
+    if (split)
+    {
+        // The sign file is already a 1-bit capture
+        const uint8_t *bytes = (const uint8_t *)capture.get_words();
+        long long bit = capture.sample_to_bit(pos);
+        long long i = 0;
+        while (i < size && (bit + i) % 8 != 0)
+        {
+            samples[i] = (bytes[(bit + i) / 8] >> ((bit + i) % 8)) & 0x1;
+            i++;
+        }
+        long long whole = (size - i) / 8;
+        unpack_bits(bytes + (bit + i) / 8, samples + i, whole);
+        i += whole * 8;
+        while (i < size)
+        {
+            samples[i] = (bytes[(bit + i) / 8] >> ((bit + i) % 8)) & 0x1;
+            i++;
+        }
+        pos += size;
+        return size;
+    }
+
+    // Decode in blocks and keep the sign
+    int8_t values[4096];
+    long long total = 0;
+    while (total < size)
+    {
+        long long n = size - total;
+        if (n > (long long)sizeof(values))
+            n = sizeof(values);
+
+        read_values(values, n);
+        for (long long k = 0; k < n; k++)
+        {
+            samples[total + k] = values[k] >= 0 ? 1 : 0;
+        }
+        total += n;
+    }
+    return total;
+}
+
+long long MultiBitFile::read_packed(uint64_t *words, long long size)
+{
+    if (!split)
+    {
+        return SampleSource::read_packed(words, size);
+    }
+
+    if (size > nsamples - pos)
+        size = nsamples - pos;
+    if (size <= 0)
+        return 0;
+
+    // Straight copy of the sign stream
+    memset(words, 0, ((size + 63) / 64) * sizeof(uint64_t));
+    copy_bits(capture.get_words(), capture.sample_to_bit(pos), words, 0, size);
+    pos += size;
+    return size;
+}
@@ -0,0 +1,56 @@
+#ifndef MULTIBIT_FILE_H
+#define MULTIBIT_FILE_H
+
+#include <stdint.h>
+#include "capture_file.h"
+#include "sig_gen.h"
+
+// Reads captures with more than one bit per sample:
+//   - MAX2769 sign and magnitude recorded to separate 1-bit files by the FPGA
+//   - Interleaved 2-bit sign/magnitude (CAPTURE_PACKING_SIGN_MAG)
+//   - Interleaved signed 8-bit I/Q (CAPTURE_PACKING_INT8_IQ)
+// A set sign bit is a positive sample and a set magnitude bit is the outer
+// level, so 2-bit samples decode to -3, -1, +1 or +3. As a SampleSource
+// only the sign (or the sign of I) is returned, for the 1-bit trackers.
+class MultiBitFile : public SampleSource
+{
+public:
+    MultiBitFile();
+    ~MultiBitFile();
+
+    // Separate sign and magnitude files, raw or in containers
+    bool open_split(const char *sign_filename, const char *magnitude_filename);
+    // Single file. Containers carry their own packing, raw files use the given one.
+    bool open(const char *filename, capture_packing_t packing = CAPTURE_PACKING_SIGN_MAG);
+    void close();
+
+    // Sample values (I for complex captures), returns the number read
+    long long read_values(int8_t *samples, long long size);
+    // Complex samples, q is zero for real captures
+    long long read_iq(int8_t *i, int8_t *q, long long size);
+
+    long long read_samples(uint8_t *samples, long long size);
+    long long read_packed(uint64_t *words, long long size);
+
+    bool seek(long long sample);
+    bool seek_time(double seconds);
+    long long tell() { return pos; }
+
+    double get_sample_rate() { return capture.get_sample_rate(); }
+    double get_if() { return capture.get_if(); }
+    long long get_nsamples() { return nsamples; }
+    bool is_complex() { return packing == CAPTURE_PACKING_INT8_IQ; }
+
+private:
+    CaptureFile capture;   // Sign bits, or the whole capture when not split
+    CaptureFile magnitude; // Magnitude bits of a split capture
+    bool split;
+    capture_packing_t packing;
+    long long nsamples;
+    long long pos;
+
+    long long read_split(int8_t *samples, long long size);
+    long long read_interleaved(int8_t *samples, long long size);
+};
+
+#endif // MULTIBIT_FILE_H
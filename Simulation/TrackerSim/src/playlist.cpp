@@ -0,0 +1,295 @@
+#include "playlist.h"
+#include "capture_file.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define PREFETCH_BYTES (16LL << 20) // Start of the next segment read ahead
+#define PAGE_BYTES 4096
+#define STAGING_WORDS 4096          // Packed reads that do not start on a word
+
+PlaylistSource::PlaylistSource()
+{
+    sample_rate = DEFAULT_FS;
+    if_freq = DEFAULT_FC;
+    total_samples = 0;
+
+    current = new SignalFromFile();
+    next = new SignalFromFile();
+    current_index = -1;
+    remaining = 0;
+    next_ok = false;
+
+    position = 0;
+}
+
+PlaylistSource::~PlaylistSource()
+{
+    close();
+    delete current;
+    delete next;
+}
+
+bool PlaylistSource::add(const char *filename)
+{
+    // Only the metadata is needed until the segment plays
+    SignalFromFile probe;
+    if (!probe.open(filename))
+    {
+        fprintf(stderr, "Error opening playlist segment %s\n", filename);
+        return false;
+    }
+
+    Segment segment;
+    segment.filename = filename;
+    segment.nsamples = probe.get_capture()->get_nsamples();
+    segment.start_time = probe.get_capture()->get_start_time();
+    segment.skip = 0;
+    double fs = probe.get_sample_rate();
+    double fc = probe.get_if();
+    probe.close();
+
+    if (segments.empty())
+    {
+        sample_rate = fs;
+        if_freq = fc;
+    }
+    else if (fs != sample_rate || fc != if_freq)
+    {
+        fprintf(stderr, "%s is at %.6f MHz with a %.6f MHz IF, the playlist is at %.6f MHz with a %.6f MHz IF\n",
+                filename, fs / 1e6, fc / 1e6, sample_rate / 1e6, if_freq / 1e6);
+        return false;
+    }
+    else
+    {
+        // Check the join when both segments know their start time
+        const Segment &prev = segments.back();
+        if (prev.start_time != 0 && segment.start_time != 0)
+        {
+            // Start times in GPS seconds only resolve a few samples, so
+            // smaller offsets count as continuous
+            double expected = prev.start_time + prev.nsamples / sample_rate;
+            long long offset = (long long)llround((segment.start_time - expected) * sample_rate);
+            double resolution = nextafter(segment.start_time, 2 * segment.start_time) - segment.start_time;
+            long long tolerance = (long long)ceil(2 * resolution * sample_rate);
+            if (llabs(offset) > tolerance)
+            {
+                PlaylistDiscontinuity discontinuity;
+                discontinuity.segment = (int)segments.size();
+                discontinuity.position = total_samples;
+                discontinuity.samples = offset;
+                discontinuity.seconds = offset / sample_rate;
+                discontinuities.push_back(discontinuity);
+
+                if (offset > 0)
+                {
+                    fprintf(stderr, "Gap of %lld samples (%.6f s) before %s\n", offset, offset / sample_rate, filename);
+                }
+                else
+                {
+                    // Drop the repeated samples so the stream stays on the timeline
+                    fprintf(stderr, "Overlap of %lld samples (%.6f s) before %s, skipped\n", -offset, -offset / sample_rate, filename);
+                    segment.skip = (-offset < segment.nsamples) ? -offset : segment.nsamples;
+                }
+            }
+        }
+    }
+
+    segments.push_back(segment);
+    total_samples += segment.nsamples - segment.skip;
+    return true;
+}
+
+bool PlaylistSource::open_list(const char *list_filename)
+{
+    FILE *list = fopen(list_filename, "r");
+    if (list == NULL)
+    {
+        return false;
+    }
+
+    // Relative paths are taken from the list's directory
+    std::string dir = list_filename;
+    size_t slash = dir.find_last_of("/\\");
+    dir = (slash == std::string::npos) ? "" : dir.substr(0, slash + 1);
+
+    bool ok = true;
+    char line[1024];
+    while (ok && fgets(line, sizeof(line), list) != NULL)
+    {
+        size_t len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t'))
+        {
+            line[--len] = '\0';
+        }
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        bool absolute = (line[0] == '/' || line[0] == '\\' || (len > 1 && line[1] == ':'));
+        std::string path = absolute ? std::string(line) : dir + line;
+        ok = add(path.c_str());
+    }
+
+    fclose(list);
+    return ok;
+}
+
+void PlaylistSource::close()
+{
+    wait_next();
+    current->close();
+    next->close();
+
+    segments.clear();
+    discontinuities.clear();
+    total_samples = 0;
+    current_index = -1;
+    remaining = 0;
+    position = 0;
+}
+
+void PlaylistSource::open_next(int index)
+{
+    next_ok = next->open(segments[index].filename.c_str());
+    if (!next_ok)
+        return;
+
+    // Fault in the start of the file so the switch does not wait on the disk
+    const uint8_t *bytes = (const uint8_t *)next->get_capture()->get_words();
+    long long nbytes = next->get_capture()->get_nbytes();
+    if (nbytes > PREFETCH_BYTES)
+        nbytes = PREFETCH_BYTES;
+    volatile uint8_t sink = 0;
+    for (long long i = 0; i < nbytes; i += PAGE_BYTES)
+    {
+        sink = sink + bytes[i];
+    }
+}
+
+void PlaylistSource::wait_next()
+{
+    if (opener.joinable())
+    {
+        opener.join();
+    }
+}
+
+bool PlaylistSource::start_segment(int index)
+{
+    const Segment &segment = segments[index];
+
+    bool ok;
+    if (index == current_index + 1 && opener.joinable())
+    {
+        // Opened ahead while the previous segment played
+        wait_next();
+        SignalFromFile *swap = current;
+        current = next;
+        next = swap;
+        next->close();
+        ok = next_ok;
+    }
+    else
+    {
+        ok = current->open(segment.filename.c_str());
+    }
+
+    if (!ok || !current->seek(segment.skip))
+    {
+        fprintf(stderr, "Error opening playlist segment %s\n", segment.filename.c_str());
+        return false;
+    }
+
+    current_index = index;
+    remaining = segment.nsamples - segment.skip;
+
+    if (index + 1 < (int)segments.size())
+    {
+        opener = std::thread(&PlaylistSource::open_next, this, index + 1);
+    }
+    return true;
+}
+
+// Samples left before the stream moves on, opening segments as needed
+long long PlaylistSource::segment_available()
+{
+    while (remaining == 0)
+    {
+        if (current_index + 1 >= (int)segments.size() || !start_segment(current_index + 1))
+            return 0;
+    }
+    return remaining;
+}
+
+long long PlaylistSource::read_samples(uint8_t *samples, long long size)
+{
+    long long total = 0;
+    while (total < size)
+    {
+        long long n = segment_available();
+        if (n == 0)
+            break;
+        if (n > size - total)
+            n = size - total;
+
+        long long got = current->read_samples(samples + total, n);
+        if (got <= 0)
+        {
+            // File shorter than its header says
+            remaining = 0;
+            continue;
+        }
+        total += got;
+        remaining -= got;
+    }
+
+    position += total;
+    return total;
+}
+
+long long PlaylistSource::read_packed(uint64_t *words, long long size)
+{
+    memset(words, 0, ((size + 63) / 64) * sizeof(uint64_t));
+
+    uint64_t *staging = nullptr;
+    long long total = 0;
+    while (total < size)
+    {
+        long long n = segment_available();
+        if (n == 0)
+            break;
+        if (n > size - total)
+            n = size - total;
+
+        long long got;
+        if (total % 64 == 0)
+        {
+            got = current->read_packed(words + total / 64, n);
+        }
+        else
+        {
+            // A segment boundary left the output mid-word
+            if (staging == nullptr)
+                staging = new uint64_t[STAGING_WORDS];
+            if (n > STAGING_WORDS * 64)
+                n = STAGING_WORDS * 64;
+            got = current->read_packed(staging, n);
+            copy_bits(staging, 0, words, total, got);
+        }
+
+        if (got <= 0)
+        {
+            remaining = 0;
+            continue;
+        }
+        total += got;
+        remaining -= got;
+    }
+
+    delete[] staging;
+    position += total;
+    return total;
+}
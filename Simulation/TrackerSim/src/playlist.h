@@ -0,0 +1,81 @@
+#ifndef PLAYLIST_H
+#define PLAYLIST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include "sig_gen.h"
+
+// Break in the timeline between two segments, found from their start times
+struct PlaylistDiscontinuity
+{
+    int segment;        // Index of the later segment
+    long long position; // Stream sample where it starts
+    long long samples;  // Positive for a gap, negative for an overlap
+    double seconds;
+};
+
+// Plays a list of 1-bit captures (one recording split into several files)
+// as a single stream. Segments join with no lost or repeated samples, and
+// the next file is opened and its first pages read on a background thread
+// while the current one plays. When both segments carry a start time, the
+// join is checked against it: overlapping samples are skipped so the
+// stream stays on the recorded timeline, and gaps are reported.
+class PlaylistSource : public SampleSource
+{
+public:
+    PlaylistSource();
+    ~PlaylistSource();
+
+    // Append a segment, false if it cannot be opened or its sample rate or
+    // IF differs from the first segment
+    bool add(const char *filename);
+    // Text file with one capture per line, blank lines and # comments skipped
+    bool open_list(const char *list_filename);
+    void close();
+
+    long long read_samples(uint8_t *samples, long long size);
+    long long read_packed(uint64_t *words, long long size);
+
+    long long tell() { return position; }
+    int get_segment() { return current_index; }
+    int get_nsegments() { return (int)segments.size(); }
+    long long get_nsamples() { return total_samples; }
+    double get_sample_rate() { return sample_rate; }
+    double get_if() { return if_freq; }
+
+    const std::vector<PlaylistDiscontinuity> &get_discontinuities() { return discontinuities; }
+
+private:
+    struct Segment
+    {
+        std::string filename;
+        long long nsamples;
+        long long skip; // Leading samples that overlap the previous segment
+        double start_time;
+    };
+
+    std::vector<Segment> segments;
+    std::vector<PlaylistDiscontinuity> discontinuities;
+    double sample_rate;
+    double if_freq;
+    long long total_samples;
+
+    // Playing segment and the one opened ahead of it
+    SignalFromFile *current;
+    SignalFromFile *next;
+    int current_index;
+    long long remaining; // Samples left in the current segment
+    std::thread opener;
+    bool next_ok;
+
+    long long position;
+
+    bool start_segment(int index);
+    void open_next(int index);
+    void wait_next();
+    long long segment_available();
+};
+
+#endif // PLAYLIST_H
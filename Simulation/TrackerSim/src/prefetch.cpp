@@ -0,0 +1,186 @@
+#include "prefetch.h"
+#include "tools.h"
+
+#include <string.h>
+#include <chrono>
+
+PrefetchSource::PrefetchSource(SampleSource *source, long long block_size, int nblocks)
+{
+    this->source = source;
+    this->block_size = (block_size + 63) / 64 * 64; // Whole words per block
+    this->nblocks = nblocks;
+
+    blocks = new Block[nblocks];
+    for (int i = 0; i < nblocks; i++)
+    {
+        blocks[i].words = (uint64_t *)aligned_malloc(this->block_size / 8);
+        blocks[i].size = 0;
+    }
+
+    // Ring state
+    head = 0;
+    tail = 0;
+    count = 0;
+    eof = false;
+    stopping = false;
+    tail_pos = 0;
+
+    // Statistics
+    underruns = 0;
+    stall_time = 0;
+    producer_waits = 0;
+
+    reader = std::thread(&PrefetchSource::reader_loop, this);
+}
+
+PrefetchSource::~PrefetchSource()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    emptied.notify_all();
+    reader.join();
+
+    for (int i = 0; i < nblocks; i++)
+    {
+        aligned_free(blocks[i].words);
+    }
+    delete[] blocks;
+}
+
+void PrefetchSource::reader_loop()
+{
+    while (true)
+    {
+        // Wait for a free block
+        Block *block;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (count == nblocks && !stopping)
+            {
+                producer_waits++;
+                emptied.wait(guard, [this]
+                             { return count < nblocks || stopping; });
+            }
+            if (stopping)
+                return;
+            block = &blocks[head];
+        }
+
+        // Read outside the lock so the consumer keeps running
+        block->size = source->read_packed(block->words, block_size);
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (block->size > 0)
+            {
+                head = (head + 1) % nblocks;
+                count++;
+            }
+            if (block->size < block_size)
+            {
+                eof = true;
+            }
+        }
+        filled.notify_one();
+
+        if (block->size < block_size)
+            return;
+    }
+}
+
+const PrefetchSource::Block *PrefetchSource::acquire_block()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (count == 0 && !eof)
+    {
+        underruns++;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        filled.wait(guard, [this]
+                    { return count > 0 || eof; });
+        stall_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return (count > 0) ? &blocks[tail] : nullptr;
+}
+
+void PrefetchSource::release_block()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tail = (tail + 1) % nblocks;
+        count--;
+    }
+    tail_pos = 0;
+    emptied.notify_one();
+}
+
+long long PrefetchSource::read_packed(uint64_t *words, long long size)
+{
+    memset(words, 0, ((size + 63) / 64) * sizeof(uint64_t));
+
+    long long total = 0;
+    while (total < size)
+    {
+        const Block *block = acquire_block();
+        if (block == nullptr)
+            break;
+
+        long long n = block->size - tail_pos;
+        if (n > size - total)
+            n = size - total;
+
+        copy_bits(block->words, tail_pos, words, total, n);
+        tail_pos += n;
+        total += n;
+
+        if (tail_pos == block->size)
+            release_block();
+    }
+    return total;
+}
+
+long long PrefetchSource::read_samples(uint8_t *samples, long long size)
+{
+    long long total = 0;
+    while (total < size)
+    {
+        const Block *block = acquire_block();
+        if (block == nullptr)
+            break;
+
+        long long n = block->size - tail_pos;
+        if (n > size - total)
+            n = size - total;
+
+        // Unpack bit by bit up to a byte boundary, then whole bytes
+        const uint8_t *bytes = (const uint8_t *)block->words;
+        long long i = 0;
+        while (i < n && (tail_pos + i) % 8 != 0)
+        {
+            samples[total + i] = (bytes[(tail_pos + i) / 8] >> ((tail_pos + i) % 8)) & 0x1;
+            i++;
+        }
+        long long whole = (n - i) / 8;
+        unpack_bits(bytes + (tail_pos + i) / 8, samples + total + i, whole);
+        i += whole * 8;
+        while (i < n)
+        {
+            samples[total + i] = (bytes[(tail_pos + i) / 8] >> ((tail_pos + i) % 8)) & 0x1;
+            i++;
+        }
+
+        tail_pos += n;
+        total += n;
+
+        if (tail_pos == block->size)
+            release_block();
+    }
+    return total;
+}
+
+long long PrefetchSource::get_producer_waits()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return producer_waits;
+}
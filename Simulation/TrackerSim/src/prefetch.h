@@ -0,0 +1,69 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "sig_gen.h"
+
+// Reads another sample source ahead of the consumer on a background thread.
+// Blocks of packed samples are kept in a ring so disk stalls overlap with
+// tracking instead of adding to it.
+class PrefetchSource : public SampleSource
+{
+public:
+    PrefetchSource(
+        SampleSource *source,
+        long long block_size = 1 << 23, // Samples per block (1 MB packed)
+        int nblocks = 8);
+
+    ~PrefetchSource();
+
+    long long read_samples(uint8_t *samples, long long size);
+    long long read_packed(uint64_t *words, long long size);
+
+    // Number of reads that found the ring empty and had to wait
+    long long get_underruns() { return underruns; }
+    // Total time the consumer spent waiting for the reader thread
+    double get_stall_time() { return stall_time; }
+    // Number of times the reader thread found the ring full
+    long long get_producer_waits();
+
+private:
+    struct Block
+    {
+        uint64_t *words;
+        long long size;
+    };
+
+    SampleSource *source;
+    long long block_size;
+    int nblocks;
+    Block *blocks;
+
+    // Ring state, guarded by lock
+    int head;  // Next block the reader thread fills
+    int tail;  // Block the consumer is reading
+    int count; // Filled blocks
+    bool eof;
+    bool stopping;
+    std::mutex lock;
+    std::condition_variable filled;
+    std::condition_variable emptied;
+    std::thread reader;
+
+    // Consumer position in the tail block
+    long long tail_pos;
+
+    // Statistics
+    long long underruns;
+    double stall_time;
+    long long producer_waits;
+
+    void reader_loop();
+    const Block *acquire_block();
+    void release_block();
+};
+
+#endif // PREFETCH_H
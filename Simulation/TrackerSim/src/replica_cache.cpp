@@ -0,0 +1,218 @@
+#include "replica_cache.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define GUARD_SAMPLES 192 // Past two periods, for the last 64 sample slice
+
+ReplicaCache::ReplicaCache(double fs, long long max_bytes, double rate_step, int phase_steps)
+{
+    this->fs = fs;
+    this->max_bytes = max_bytes;
+    this->rate_step = rate_step;
+    this->phase_steps = phase_steps;
+
+    bytes = 0;
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
+
+ReplicaCache::~ReplicaCache()
+{
+    for (std::list<Entry *>::iterator it = lru.begin(); it != lru.end(); ++it)
+    {
+        aligned_free((*it)->words);
+        delete *it;
+    }
+}
+
+int ReplicaCache::get_code_length(replica_code_t code)
+{
+    return (code == REPLICA_E1B || code == REPLICA_E1C) ? 4092 : 1023;
+}
+
+const std::vector<uint8_t> &ReplicaCache::get_chips(replica_code_t code, int prn)
+{
+    std::pair<int, int> id((int)code, prn);
+    std::map<std::pair<int, int>, std::vector<uint8_t> >::iterator found = chips.find(id);
+    if (found != chips.end())
+        return found->second;
+
+    int length = get_code_length(code);
+    std::vector<uint8_t> &period = chips[id];
+    period.resize(length);
+
+    if (code == REPLICA_GPS_CA)
+    {
+        CACodeGenerator gen(l1_taps[prn - 1][0], l1_taps[prn - 1][1]);
+        for (int i = 0; i < length; i++)
+        {
+            period[i] = gen.get_chip();
+            gen.clock_chip();
+        }
+    }
+    else if (code == REPLICA_WAAS)
+    {
+        int g2_delay = -1;
+        for (size_t i = 0; i < sizeof(waas_code_params) / sizeof(waas_code_params[0]); i++)
+        {
+            if (waas_code_params[i][0] == prn)
+            {
+                g2_delay = waas_code_params[i][1];
+                break;
+            }
+        }
+        if (g2_delay < 0)
+        {
+            fprintf(stderr, "WAAS PRN %d not found in waas_code_params\n", prn);
+            exit(1);
+        }
+
+        WAASCodeGenerator gen(g2_delay);
+        for (int i = 0; i < length; i++)
+        {
+            period[i] = gen.get_chip();
+            gen.clock_chip();
+        }
+    }
+    else
+    {
+        GalileoE1CodeGenerator gen(prn - 1);
+        for (int i = 0; i < length; i++)
+        {
+            period[i] = (code == REPLICA_E1B) ? gen.get_data_chip() : gen.get_chip();
+            gen.clock_chip();
+        }
+    }
+    return period;
+}
+
+ReplicaCache::Entry *ReplicaCache::build(const Key &key)
+{
+    const std::vector<uint8_t> &period = get_chips((replica_code_t)key.code, key.prn);
+    int length = (int)period.size();
+
+    double rate = key.rate_bucket * rate_step / fs;
+    double phase = rate * key.phase_bucket / phase_steps;
+    long long nsamples = (long long)ceil(2 * length / rate) + GUARD_SAMPLES;
+    long long nwords = (nsamples + 63) / 64;
+
+    Entry *entry = new Entry;
+    entry->words = (uint64_t *)aligned_malloc(nwords * sizeof(uint64_t));
+    memset(entry->words, 0, nwords * sizeof(uint64_t));
+
+    // Fill the samples of each set chip, a run of about 1 / rate samples
+    long long begin = 0;
+    for (long long c = 0; begin < nsamples; c++)
+    {
+        // First sample past chip c, moved to where the per-sample phase agrees
+        long long end = (long long)ceil((c + 1 - phase) / rate);
+        while (end > begin && (long long)(phase + (end - 1) * rate) > c)
+            end--;
+        while ((long long)(phase + end * rate) <= c)
+            end++;
+        if (end > nsamples)
+            end = nsamples;
+
+        if (period[c % length])
+        {
+            for (long long i = begin; i < end;)
+            {
+                int bit = (int)(i & 63);
+                int n = (end - i < 64 - bit) ? (int)(end - i) : 64 - bit;
+                uint64_t mask = (n == 64) ? ~0ULL : (((1ULL << n) - 1) << bit);
+                entry->words[i >> 6] |= mask;
+                i += n;
+            }
+        }
+        begin = end;
+    }
+
+    entry->replica.words = entry->words;
+    entry->replica.nsamples = nsamples;
+    entry->replica.rate = rate;
+    entry->replica.phase = phase;
+    entry->key = key;
+    entry->nbytes = nwords * sizeof(uint64_t);
+    entry->refs = 0;
+    return entry;
+}
+
+// Drop the least recently used replicas nobody holds until under budget
+void ReplicaCache::evict()
+{
+    std::list<Entry *>::iterator it = lru.end();
+    while (bytes > max_bytes && it != lru.begin())
+    {
+        --it;
+        Entry *entry = *it;
+        if (entry->refs > 0)
+            continue;
+
+        entries.erase(entry->key);
+        bytes -= entry->nbytes;
+        aligned_free(entry->words);
+        delete entry;
+        it = lru.erase(it);
+        evictions++;
+    }
+}
+
+const CodeReplica *ReplicaCache::acquire(replica_code_t code, int prn, double chip_rate, double start, long long *offset)
+{
+    int length = get_code_length(code);
+
+    Key key;
+    key.code = (int)code;
+    key.prn = prn;
+    key.rate_bucket = llround(chip_rate / rate_step);
+    double rate = key.rate_bucket * rate_step / fs;
+
+    // Split the start into whole samples and a rounded fraction of one
+    start = fmod(start, (double)length);
+    if (start < 0)
+        start += length;
+    long long samples = (long long)floor(start / rate);
+    key.phase_bucket = (int)llround((start - samples * rate) / rate * phase_steps);
+    if (key.phase_bucket >= phase_steps)
+    {
+        key.phase_bucket -= phase_steps;
+        samples++;
+    }
+    *offset = samples;
+
+    Entry *entry;
+    std::map<Key, std::list<Entry *>::iterator>::iterator found = entries.find(key);
+    if (found != entries.end())
+    {
+        hits++;
+        entry = *found->second;
+        lru.splice(lru.begin(), lru, found->second);
+        entry->refs++;
+    }
+    else
+    {
+        // Held before evicting, so the new replica stays
+        misses++;
+        entry = build(key);
+        entry->refs++;
+        lru.push_front(entry);
+        entries[key] = lru.begin();
+        bytes += entry->nbytes;
+        evict();
+    }
+    return &entry->replica;
+}
+
+void ReplicaCache::release(const CodeReplica *replica)
+{
+    // The replica is the first member of its entry
+    Entry *entry = (Entry *)replica;
+    entry->refs--;
+    if (entry->refs == 0 && bytes > max_bytes)
+        evict();
+}
@@ -0,0 +1,122 @@
+#ifndef REPLICA_CACHE_H
+#define REPLICA_CACHE_H
+
+#include <stdint.h>
+#include <map>
+#include <list>
+#include <vector>
+
+typedef enum
+{
+    REPLICA_GPS_CA = 0, // CACodeGenerator, PRN 1 to 32
+    REPLICA_WAAS = 1,   // WAASCodeGenerator, PRN from waas_code_params
+    REPLICA_E1B = 2,    // GalileoE1CodeGenerator data chips, PRN 1 to 50
+    REPLICA_E1C = 3,    // GalileoE1CodeGenerator pilot chips, PRN 1 to 50
+} replica_code_t;
+
+// Two code periods sampled at the sample rate, LSB-first packed. Sample i
+// is the chip at code phase (phase + i * rate) chips from chip 0.
+struct CodeReplica
+{
+    const uint64_t *words;
+    long long nsamples;
+    double rate;  // Chips per sample
+    double phase; // Chips at sample 0, below one sample
+};
+
+// Sample-rate code replicas shared between trackers. A replica is kept
+// per PRN, per code rate rounded to rate_step chips/s and per start
+// phase rounded to 1/phase_steps of a sample, so a tracker can slice its
+// early, prompt and late words out of one at any code phase instead of
+// clocking a code generator sample by sample. The rounding is the cost:
+// replica timing is only as exact as the steps.
+//
+// The cache holds at most max_bytes of replicas it can evict, dropping
+// the least recently used first. Replicas still held by a tracker are
+// never evicted. Not thread safe, use one cache per tracking thread.
+class ReplicaCache
+{
+public:
+    ReplicaCache(
+        double fs,
+        long long max_bytes = 64LL << 20,
+        double rate_step = 0.05,
+        int phase_steps = 16);
+
+    ~ReplicaCache();
+
+    // Replica for a code running at chip_rate chips/s, and the sample in it
+    // where code phase start (chips, any value) falls. The replica holds
+    // at least one code period plus 64 samples from there. Hold it until
+    // release().
+    const CodeReplica *acquire(replica_code_t code, int prn, double chip_rate, double start, long long *offset);
+    void release(const CodeReplica *replica);
+
+    // 64 samples of a replica from sample pos
+    static inline uint64_t slice(const CodeReplica *replica, long long pos)
+    {
+        const uint64_t *w = replica->words + (pos >> 6);
+        int shift = (int)(pos & 63);
+        if (shift == 0)
+            return w[0];
+        return (w[0] >> shift) | (w[1] << (64 - shift));
+    }
+
+    static int get_code_length(replica_code_t code);
+
+    long long get_bytes() { return bytes; }
+    long long get_hits() { return hits; }
+    long long get_misses() { return misses; }
+    long long get_evictions() { return evictions; }
+
+private:
+    struct Key
+    {
+        int code;
+        int prn;
+        long long rate_bucket;
+        int phase_bucket;
+
+        bool operator<(const Key &other) const
+        {
+            if (code != other.code)
+                return code < other.code;
+            if (prn != other.prn)
+                return prn < other.prn;
+            if (rate_bucket != other.rate_bucket)
+                return rate_bucket < other.rate_bucket;
+            return phase_bucket < other.phase_bucket;
+        }
+    };
+
+    struct Entry
+    {
+        CodeReplica replica; // First member, so a replica pointer finds its entry
+        Key key;
+        uint64_t *words;
+        long long nbytes;
+        int refs;
+    };
+
+    double fs;
+    long long max_bytes;
+    double rate_step;
+    int phase_steps;
+
+    // Most recently used first
+    std::list<Entry *> lru;
+    std::map<Key, std::list<Entry *>::iterator> entries;
+    // One period of chips per code and PRN, generated once
+    std::map<std::pair<int, int>, std::vector<uint8_t> > chips;
+
+    long long bytes;
+    long long hits;
+    long long misses;
+    long long evictions;
+
+    const std::vector<uint8_t> &get_chips(replica_code_t code, int prn);
+    Entry *build(const Key &key);
+    void evict();
+};
+
+#endif // REPLICA_CACHE_H
@@ -0,0 +1,167 @@
+#include "sample_bus.h"
+#include "tools.h"
+
+SampleBus::SampleBus(SampleSource *source, long long block_size, int nblocks)
+{
+    this->source = source;
+    this->block_size = block_size;
+    this->nblocks = nblocks;
+
+    // Whole words and bytes, so unpacking can run past the last sample
+    long long nwords = (block_size + 63) / 64;
+    slots = new Slot[nblocks];
+    for (int i = 0; i < nblocks; i++)
+    {
+        slots[i].words = (uint64_t *)aligned_malloc(nwords * sizeof(uint64_t));
+        slots[i].samples = (uint8_t *)aligned_malloc(nwords * 64);
+        slots[i].block.words = slots[i].words;
+        slots[i].block.samples = slots[i].samples;
+        slots[i].block.size = 0;
+        slots[i].block.first_sample = 0;
+        slots[i].refs = 0;
+        slots[i].seq = -1;
+    }
+
+    published = 0;
+    nconsumers = 0;
+    eof = false;
+    position = 0;
+    producer_waits = 0;
+}
+
+SampleBus::~SampleBus()
+{
+    for (int i = 0; i < nblocks; i++)
+    {
+        aligned_free(slots[i].words);
+        aligned_free(slots[i].samples);
+    }
+    delete[] slots;
+}
+
+int SampleBus::subscribe()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    nconsumers++;
+    for (size_t i = 0; i < cursors.size(); i++)
+    {
+        if (cursors[i] < 0)
+        {
+            cursors[i] = published;
+            return (int)i;
+        }
+    }
+    cursors.push_back(published);
+    return (int)cursors.size() - 1;
+}
+
+void SampleBus::unsubscribe(int consumer)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (long long seq = cursors[consumer]; seq < published; seq++)
+        {
+            Slot *slot = &slots[seq % nblocks];
+            slot->refs--;
+            if (slot->refs == 0)
+                slot->seq = -1;
+        }
+        cursors[consumer] = -1;
+        nconsumers--;
+    }
+    freed.notify_all();
+}
+
+const SampleBlock *SampleBus::publish()
+{
+    // Blocks are handed out in order, so the next slot is always the oldest
+    Slot *slot = &slots[published % nblocks];
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (eof || nconsumers == 0)
+            return nullptr;
+        if (slot->seq >= 0)
+        {
+            producer_waits++;
+            freed.wait(guard, [slot]
+                       { return slot->seq < 0; });
+        }
+    }
+
+    // Decode outside the lock, nobody holds this slot
+    long long n = source->read_packed(slot->words, block_size);
+    if (n > 0)
+    {
+        unpack_bits((const uint8_t *)slot->words, slot->samples, (n + 7) / 8);
+    }
+    slot->block.size = n;
+    slot->block.first_sample = position;
+    position += n;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (n <= 0)
+        {
+            eof = true;
+        }
+        else if (nconsumers == 0)
+        {
+            // The last consumer left during the decode, nobody would free
+            // the slot, so leave it free and publish nothing
+            n = 0;
+        }
+        else
+        {
+            slot->refs = nconsumers;
+            slot->seq = published;
+            published++;
+        }
+    }
+    available.notify_all();
+
+    return (n > 0) ? &slot->block : nullptr;
+}
+
+const SampleBlock *SampleBus::next(int consumer)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    available.wait(guard, [this, consumer]
+                   { return cursors[consumer] < published || eof; });
+    if (cursors[consumer] == published)
+        return nullptr;
+
+    Slot *slot = &slots[cursors[consumer] % nblocks];
+    cursors[consumer]++;
+    return &slot->block;
+}
+
+SampleBus::Slot *SampleBus::find_slot(const SampleBlock *block)
+{
+    // The block is the first member of its slot
+    return (Slot *)block;
+}
+
+void SampleBus::drop_reference(Slot *slot)
+{
+    bool last;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        slot->refs--;
+        last = (slot->refs == 0);
+        if (last)
+            slot->seq = -1;
+    }
+    if (last)
+        freed.notify_all();
+}
+
+void SampleBus::release(const SampleBlock *block)
+{
+    drop_reference(find_slot(block));
+}
+
+void SampleBus::retain(const SampleBlock *block)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    find_slot(block)->refs++;
+}
@@ -0,0 +1,91 @@
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include <stdint.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "sig_gen.h"
+
+// One block of input, decoded once and shared read-only by every consumer
+struct SampleBlock
+{
+    const uint64_t *words;   // LSB-first packed samples
+    const uint8_t *samples;  // The same samples unpacked, one (0 or 1) per byte
+    long long size;          // Samples in the block
+    long long first_sample;  // Position of the first sample in the stream
+};
+
+// Fans blocks from one SampleSource out to any number of consumers without
+// copying. The producer publishes each block once. Every subscriber then
+// holds a reference to it until it calls release(), and the block goes
+// back to the pool after the last one. Consumers can run on other
+// threads; a consumer that falls behind holds blocks and, once the pool is
+// used up, stalls the producer rather than losing data.
+//
+// On a single thread, consume and release each published block before
+// publishing the next one once the pool is full.
+class SampleBus
+{
+public:
+    SampleBus(
+        SampleSource *source,
+        long long block_size,
+        int nblocks = 16);
+
+    ~SampleBus();
+
+    // Subscribers only see blocks published after they subscribe. Returns
+    // the consumer id passed to next().
+    int subscribe();
+    // Drops the consumer and its references to blocks it has not read
+    void unsubscribe(int consumer);
+
+    // Read, unpack and publish the next block. Returns nullptr at the end of
+    // the source, or when nobody is subscribed.
+    const SampleBlock *publish();
+
+    // Next block for a consumer in publish order, waiting for the producer.
+    // Returns nullptr once the source has ended and every block was read.
+    // The block stays valid until the consumer releases it.
+    const SampleBlock *next(int consumer);
+    void release(const SampleBlock *block);
+    // Extra reference, for a consumer that keeps a block past the next one
+    void retain(const SampleBlock *block);
+
+    long long get_block_size() { return block_size; }
+    // Number of publishes that waited for a consumer to release a block
+    long long get_producer_waits() { return producer_waits; }
+
+private:
+    struct Slot
+    {
+        SampleBlock block;
+        uint64_t *words;
+        uint8_t *samples;
+        int refs;
+        long long seq; // Publish order, -1 when free
+    };
+
+    SampleSource *source;
+    long long block_size;
+    int nblocks;
+    Slot *slots;
+
+    // Guarded by lock
+    long long published;            // Blocks published so far
+    std::vector<long long> cursors; // Next sequence per consumer, -1 when unused
+    int nconsumers;
+    bool eof;
+    std::mutex lock;
+    std::condition_variable available;
+    std::condition_variable freed;
+
+    long long position;
+    long long producer_waits;
+
+    Slot *find_slot(const SampleBlock *block);
+    void drop_reference(Slot *slot);
+};
+
+#endif // SAMPLE_BUS_H
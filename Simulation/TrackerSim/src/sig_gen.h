@@ -3,8 +3,22 @@
 
 #include <stdint.h>
 #include <random>
+#include "capture_file.h"
 
-class SignalFromFile
+// Common block interface for sources of 1-bit samples
+class SampleSource
+{
+public:
+    virtual ~SampleSource() {}
+
+    // Fill samples with up to size samples (0 or 1), returns the number read
+    virtual long long read_samples(uint8_t *samples, long long size) = 0;
+
+    // Fill words with up to size LSB-first packed samples, returns the number read
+    virtual long long read_packed(uint64_t *words, long long size);
+};
+
+class SignalFromFile : public SampleSource
 {
 public:
     SignalFromFile();
@@ -13,14 +27,27 @@ public:
     void close();
     void generate(double *signal, long long size);
 
+    long long read_samples(uint8_t *samples, long long size);
+    long long read_packed(uint64_t *words, long long size);
+
+    // Jump to a sample or to a time from the start of the capture
+    bool seek(long long sample);
+    bool seek_time(double seconds);
+    long long tell() { return nbyte * 8 + nbit; }
+
+    double get_sample_rate() { return capture.get_sample_rate(); }
+    double get_if() { return capture.get_if(); }
+
+    // Packed view of the whole capture for consumers that work on words
+    CaptureFile *get_capture() { return &capture; }
+
 private:
-    FILE *file;
-    char byte;
+    CaptureFile capture;
     long long nbyte;
     int nbit;
 };
 
-class NoiseGen
+class NoiseGen : public SampleSource
 {
 public:
     NoiseGen(
@@ -29,6 +56,7 @@ public:
         double bandwidth = 18e6); // MAX-2769 wideband setting
 
     void generate(double *signal, long long size);
+    long long read_samples(uint8_t *samples, long long size);
 
 private:
     double fs;
@@ -37,7 +65,7 @@ private:
     std::normal_distribution<double> noise;
 };
 
-class GPSL1CASigGen
+class GPSL1CASigGen : public SampleSource
 {
 public:
     GPSL1CASigGen(
@@ -48,6 +76,7 @@ public:
         double doppler_end = 0);
 
     void generate(double *signal, long long size);
+    long long read_samples(uint8_t *samples, long long size);
 
 private:
     double fs;
@@ -57,7 +86,7 @@ private:
     double doppler_end;
 };
 
-class GalileoE1SigGen
+class GalileoE1SigGen : public SampleSource
 {
 public:
     GalileoE1SigGen(
@@ -68,6 +97,7 @@ public:
         double doppler_end = 0);
 
     void generate(double *signal, long long size);
+    long long read_samples(uint8_t *samples, long long size);
 
 private:
     double fs;
@@ -0,0 +1,453 @@
+#include "stream_source.h"
+#include "tools.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <io.h>
+#include <fcntl.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// How long the receiver waits for data before checking for close()
+#define POLL_TIMEOUT_MS 100
+// How long the consumer sleeps while the ring is empty
+#define WAIT_US 50
+
+// Seconds on the monotonic clock
+static double now_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+StreamSource::StreamSource(long long block_size, int nblocks)
+{
+    this->block_size = (block_size + 63) / 64 * 64; // Whole words per block
+    this->nblocks = nblocks;
+
+    blocks = new Block[nblocks];
+    for (int i = 0; i < nblocks; i++)
+    {
+        blocks[i].words = (uint64_t *)aligned_malloc(this->block_size / 8);
+        blocks[i].size = 0;
+    }
+    spare.words = (uint64_t *)aligned_malloc(this->block_size / 8);
+    spare.size = 0;
+
+    head = 0;
+    tail = 0;
+    eof = true;
+    stopping = false;
+
+    fd = -1;
+    is_socket = false;
+    is_stdin = false;
+
+    tail_pos = 0;
+    block_start = 0;
+    block_time = 0;
+    underruns = 0;
+
+    received = 0;
+    overruns = 0;
+    dropped = 0;
+}
+
+StreamSource::~StreamSource()
+{
+    close();
+
+    for (int i = 0; i < nblocks; i++)
+    {
+        aligned_free(blocks[i].words);
+    }
+    delete[] blocks;
+    aligned_free(spare.words);
+}
+
+bool StreamSource::open(const char *address)
+{
+    close();
+
+    if (strcmp(address, "-") == 0)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        fd = _fileno(stdin);
+#else
+        fd = STDIN_FILENO;
+#endif
+        is_stdin = true;
+    }
+    else if (strncmp(address, "tcp:", 4) == 0 || strncmp(address, "unix:", 5) == 0)
+    {
+        if (!connect_socket(address))
+        {
+            return false;
+        }
+        is_socket = true;
+    }
+    else
+    {
+        // Opening a FIFO blocks until the writer connects
+#ifdef _WIN32
+        fd = _open(address, _O_RDONLY | _O_BINARY);
+#else
+        fd = ::open(address, O_RDONLY);
+#endif
+        if (fd < 0)
+        {
+            return false;
+        }
+    }
+
+    head = 0;
+    tail = 0;
+    eof = false;
+    stopping = false;
+    tail_pos = 0;
+    block_start = 0;
+    block_time = 0;
+    underruns = 0;
+    received = 0;
+    overruns = 0;
+    dropped = 0;
+
+    receiver = std::thread(&StreamSource::receiver_loop, this);
+    return true;
+}
+
+bool StreamSource::connect_socket(const char *address)
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    {
+        return false;
+    }
+#endif
+
+    if (strncmp(address, "unix:", 5) == 0)
+    {
+#ifdef _WIN32
+        fprintf(stderr, "Unix sockets are not supported on Windows\n");
+        WSACleanup();
+        return false;
+#else
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(address + 5) >= sizeof(addr.sun_path))
+        {
+            return false;
+        }
+        strcpy(addr.sun_path, address + 5);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    // tcp:<host>:<port>
+    char host[256];
+    const char *port = strrchr(address + 4, ':');
+    if (port == NULL || port - (address + 4) >= (long long)sizeof(host))
+    {
+        fprintf(stderr, "Expected tcp:<host>:<port>\n");
+        return false;
+    }
+    memcpy(host, address + 4, port - (address + 4));
+    host[port - (address + 4)] = '\0';
+    port++;
+
+    struct addrinfo hints;
+    struct addrinfo *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &result) != 0)
+    {
+        return false;
+    }
+
+    fd = -1;
+    for (struct addrinfo *ai = result; ai != NULL && fd < 0; ai = ai->ai_next)
+    {
+        long long s = (long long)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (s < 0)
+            continue;
+        if (connect(s, ai->ai_addr, (int)ai->ai_addrlen) == 0)
+        {
+            fd = s;
+            break;
+        }
+#ifdef _WIN32
+        closesocket(s);
+#else
+        ::close(s);
+#endif
+    }
+    freeaddrinfo(result);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // Large kernel buffer to ride out scheduling hiccups
+    int rcvbuf = 8 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, (const char *)&rcvbuf, sizeof(rcvbuf));
+    return true;
+}
+
+void StreamSource::close()
+{
+    if (receiver.joinable())
+    {
+        stopping = true;
+        receiver.join();
+    }
+
+    if (fd >= 0)
+    {
+#ifdef _WIN32
+        if (is_socket)
+        {
+            closesocket(fd);
+            WSACleanup();
+        }
+        else if (!is_stdin)
+        {
+            _close((int)fd);
+        }
+#else
+        if (!is_stdin)
+        {
+            ::close(fd);
+        }
+#endif
+    }
+
+    fd = -1;
+    is_socket = false;
+    is_stdin = false;
+    eof = true;
+}
+
+// Returns the number of bytes received, 0 at the end of the stream or -1
+// if nothing arrived before the timeout
+long long StreamSource::receive(uint8_t *buf, long long size)
+{
+#ifdef _WIN32
+    if (is_socket)
+    {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET((SOCKET)fd, &set);
+        struct timeval timeout = {0, POLL_TIMEOUT_MS * 1000};
+        int ready = select(0, &set, NULL, NULL, &timeout);
+        if (ready == 0)
+            return -1;
+        if (ready < 0)
+            return 0;
+        int n = recv((SOCKET)fd, (char *)buf, (int)size, 0);
+        return (n < 0) ? 0 : n;
+    }
+
+    // Pipes and files block on Windows, close() waits for the next read
+    int n = _read((int)fd, buf, (unsigned int)size);
+    return (n < 0) ? 0 : n;
+#else
+    struct pollfd p;
+    p.fd = (int)fd;
+    p.events = POLLIN;
+    p.revents = 0;
+    int ready = poll(&p, 1, POLL_TIMEOUT_MS);
+    if (ready == 0 || (ready < 0 && errno == EINTR))
+        return -1;
+    if (ready < 0)
+        return 0;
+
+    ssize_t n = is_socket ? recv((int)fd, buf, size, 0) : ::read((int)fd, buf, size);
+    if (n < 0)
+        return (errno == EINTR || errno == EAGAIN) ? -1 : 0;
+    return n;
+#endif
+}
+
+void StreamSource::receiver_loop()
+{
+    double start_time = now_seconds();
+    long long block_bytes = block_size / 8;
+    long long position = 0;
+
+    while (!stopping)
+    {
+        // Fill the head block, or the spare one if the ring is full
+        uint64_t h = head.load(std::memory_order_relaxed);
+        bool full = h - tail.load(std::memory_order_acquire) == (uint64_t)nblocks;
+        Block *block = full ? &spare : &blocks[h % nblocks];
+
+        uint8_t *bytes = (uint8_t *)block->words;
+        long long nbytes = 0;
+        bool done = false;
+        while (nbytes < block_bytes && !stopping)
+        {
+            long long n = receive(bytes + nbytes, block_bytes - nbytes);
+            if (n == 0)
+            {
+                done = true;
+                break;
+            }
+            if (n > 0)
+                nbytes += n;
+        }
+
+        block->size = nbytes * 8;
+        block->first_sample = position;
+        block->time = now_seconds() - start_time;
+        position += block->size;
+        received.fetch_add(block->size, std::memory_order_relaxed);
+
+        // The consumer may have caught up while the spare was filling
+        if (full && h - tail.load(std::memory_order_acquire) < (uint64_t)nblocks)
+        {
+            Block *slot = &blocks[h % nblocks];
+            memcpy(slot->words, spare.words, nbytes);
+            slot->size = spare.size;
+            slot->first_sample = spare.first_sample;
+            slot->time = spare.time;
+            full = false;
+        }
+
+        if (full)
+        {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            dropped.fetch_add(block->size, std::memory_order_relaxed);
+        }
+        else if (block->size > 0)
+        {
+            head.store(h + 1, std::memory_order_release);
+        }
+
+        if (done)
+            break;
+    }
+
+    eof.store(true, std::memory_order_release);
+}
+
+const StreamSource::Block *StreamSource::acquire_block()
+{
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+    {
+        underruns++;
+        while (head.load(std::memory_order_acquire) == t)
+        {
+            // Check eof before head so a final block is not missed
+            if (eof.load(std::memory_order_acquire) && head.load(std::memory_order_acquire) == t)
+                return nullptr;
+            std::this_thread::sleep_for(std::chrono::microseconds(WAIT_US));
+        }
+    }
+
+    const Block *block = &blocks[t % nblocks];
+    if (tail_pos == 0)
+    {
+        block_start = block->first_sample;
+        block_time = block->time;
+    }
+    return block;
+}
+
+void StreamSource::release_block()
+{
+    block_start += tail_pos;
+    tail_pos = 0;
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+long long StreamSource::read_packed(uint64_t *words, long long size)
+{
+    memset(words, 0, ((size + 63) / 64) * sizeof(uint64_t));
+
+    long long total = 0;
+    while (total < size)
+    {
+        const Block *block = acquire_block();
+        if (block == nullptr)
+            break;
+
+        long long n = block->size - tail_pos;
+        if (n > size - total)
+            n = size - total;
+
+        copy_bits(block->words, tail_pos, words, total, n);
+        tail_pos += n;
+        total += n;
+
+        if (tail_pos == block->size)
+            release_block();
+    }
+    return total;
+}
+
+long long StreamSource::read_samples(uint8_t *samples, long long size)
+{
+    long long total = 0;
+    while (total < size)
+    {
+        const Block *block = acquire_block();
+        if (block == nullptr)
+            break;
+
+        long long n = block->size - tail_pos;
+        if (n > size - total)
+            n = size - total;
+
+        // Unpack bit by bit up to a byte boundary, then whole bytes
+        const uint8_t *bytes = (const uint8_t *)block->words;
+        long long i = 0;
+        while (i < n && (tail_pos + i) % 8 != 0)
+        {
+            samples[total + i] = (bytes[(tail_pos + i) / 8] >> ((tail_pos + i) % 8)) & 0x1;
+            i++;
+        }
+        long long whole = (n - i) / 8;
+        unpack_bits(bytes + (tail_pos + i) / 8, samples + total + i, whole);
+        i += whole * 8;
+        while (i < n)
+        {
+            samples[total + i] = (bytes[(tail_pos + i) / 8] >> ((tail_pos + i) % 8)) & 0x1;
+            i++;
+        }
+
+        tail_pos += n;
+        total += n;
+
+        if (tail_pos == block->size)
+            release_block();
+    }
+    return total;
+}
@@ -0,0 +1,91 @@
+#ifndef STREAM_SOURCE_H
+#define STREAM_SOURCE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include "sig_gen.h"
+
+// Live 1-bit samples from a front-end feed, packed LSB-first like the raw
+// captures. The address selects the transport:
+//   "-"                standard input
+//   "tcp:<host>:<port>" TCP connection to a sender
+//   "unix:<path>"      Unix domain socket (not on Windows)
+//   anything else      path of a named FIFO (or a plain file)
+// A receiver thread fills a lock-free single producer/consumer ring of
+// blocks. The feed cannot be paused, so when the ring is full the block is
+// dropped and counted rather than stalling the sender.
+class StreamSource : public SampleSource
+{
+public:
+    StreamSource(
+        long long block_size = 1 << 16, // Samples per block (~1 ms at 69.984 MHz)
+        int nblocks = 256);
+
+    ~StreamSource();
+
+    bool open(const char *address);
+    void close();
+
+    long long read_samples(uint8_t *samples, long long size);
+    long long read_packed(uint64_t *words, long long size);
+
+    // Stream position of the next sample, dropped samples included, so
+    // overruns show up as jumps
+    long long tell() { return block_start + tail_pos; }
+    // Arrival time of the block holding the last sample read, in seconds
+    // since open(), taken when its final byte was received
+    double get_block_time() { return block_time; }
+
+    // Receiver statistics, safe to read while streaming
+    long long get_received_samples() { return received.load(std::memory_order_relaxed); }
+    long long get_overruns() { return overruns.load(std::memory_order_relaxed); }
+    long long get_dropped_samples() { return dropped.load(std::memory_order_relaxed); }
+    // Number of reads that found the ring empty and had to wait
+    long long get_underruns() { return underruns; }
+
+private:
+    struct Block
+    {
+        uint64_t *words;
+        long long size;        // Samples
+        long long first_sample; // Stream position of the first sample
+        double time;
+    };
+
+    long long block_size;
+    int nblocks;
+    Block *blocks;
+    Block spare; // Receives data while the ring is full
+
+    // Ring indices, each written by one side only
+    std::atomic<uint64_t> head; // Blocks published by the receiver
+    std::atomic<uint64_t> tail; // Blocks released by the consumer
+    std::atomic<bool> eof;
+    std::atomic<bool> stopping;
+    std::thread receiver;
+
+    // Connection
+    long long fd;
+    bool is_socket;
+    bool is_stdin;
+
+    // Consumer state
+    long long tail_pos;
+    long long block_start;
+    double block_time;
+    long long underruns;
+
+    // Statistics
+    std::atomic<long long> received;
+    std::atomic<long long> overruns;
+    std::atomic<long long> dropped;
+
+    bool connect_socket(const char *address);
+    long long receive(uint8_t *buf, long long size);
+    void receiver_loop();
+    const Block *acquire_block();
+    void release_block();
+};
+
+#endif // STREAM_SOURCE_H
@@ -1,91 +1,99 @@
 #include "tools.h"
 
 #include <string.h>
+#include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
 
-CACodeGenerator::CACodeGenerator(uint8_t tap1, uint8_t tap2, int chip_start)
+#define WAAS_CODES (sizeof(waas_code_params) / sizeof(waas_code_params[0]))
+
+struct L1CACodeTables
 {
-    this->tap1 = tap1;
-    this->tap2 = tap2;
-    this->chip = 0;
+    CodeTable prn[32];
+};
 
-    // Initial conditions
-    for (int i = 0; i < 11; i++)
-    {
-        g1[i] = 1;
-        g2[i] = 1;
-    }
+struct WAASCodeTables
+{
+    CodeTable code[WAAS_CODES];
+};
 
-    // Wind to the initial chip
-    for (int i = 0; i < chip_start; i++)
-    {
-        // Update chip
-        clock_chip();
-    }
+template <int... I>
+constexpr L1CACodeTables make_l1ca_tables(IndexList<I...>)
+{
+    return L1CACodeTables{{l1ca_code<I + 1>()...}};
 }
 
-void CACodeGenerator::clock_chip()
+template <int... I>
+constexpr WAASCodeTables make_waas_tables(IndexList<I...>)
 {
-    // Update G1
-    g1[0] = g1[3] ^ g1[10];
-
-    // Update G2
-    g2[0] = g2[2] ^ g2[3] ^ g2[6] ^ g2[8] ^ g2[9] ^ g2[10];
+    return WAASCodeTables{{waas_code<I>()...}};
+}
 
-    // Shift registers
-    memmove(g1 + 1, g1, 10);
-    memmove(g2 + 1, g2, 10);
+static constexpr L1CACodeTables l1ca_tables = make_l1ca_tables(MakeIndexList<32>::type());
+static constexpr WAASCodeTables waas_tables = make_waas_tables(MakeIndexList<WAAS_CODES>::type());
 
-    // Update chip
-    chip = (chip + 1) % 1023;
+const uint32_t *l1ca_code_table(int prn)
+{
+    if (prn < 1 || prn > 32)
+        return NULL;
+    return l1ca_tables.prn[prn - 1].words;
 }
 
-uint8_t CACodeGenerator::get_chip()
+const uint32_t *waas_code_table(int prn)
 {
-    return g1[10] ^ g2[tap1] ^ g2[tap2];
+    for (size_t i = 0; i < WAAS_CODES; i++)
+    {
+        if (waas_code_params[i][0] == prn)
+            return waas_tables.code[i].words;
+    }
+    return NULL;
 }
 
-WAASCodeGenerator::WAASCodeGenerator(int g2_delay, int chip_start)
+CACodeGenerator::CACodeGenerator(uint8_t tap1, uint8_t tap2, int chip_start)
 {
-    this->chip = 0;
-
-    // Initial conditions
-    g1[0] = 1;
-    g2[0] = 1;
-    for (int i = 0; i < 10; i++)
+    // The PRN with these G2 taps
+    table = NULL;
+    for (int i = 0; i < 32; i++)
     {
-        g1[i + 1] = 1;
-        g2[i + 1] = (g2_delay >> i) & 1;
+        if (l1_taps[i][0] == tap1 && l1_taps[i][1] == tap2)
+        {
+            table = l1ca_code_table(i + 1);
+            break;
+        }
     }
-
-    // Wind to the initial chip
-    for (int i = 0; i < chip_start; i++)
+    if (table == NULL)
     {
-        // Update chip
-        clock_chip();
+        fprintf(stderr, "No GPS PRN with G2 taps %d and %d\n", tap1, tap2);
+        exit(1);
     }
-}
-
-void WAASCodeGenerator::clock_chip()
-{
-    // Update G1
-    g1[0] = g1[3] ^ g1[10];
-
-    // Update G2
-    g2[0] = g2[2] ^ g2[3] ^ g2[6] ^ g2[8] ^ g2[9] ^ g2[10];
 
-    // Shift registers
-    memmove(g1 + 1, g1, 10);
-    memmove(g2 + 1, g2, 10);
-
-    // Update chip
-    chip = (chip + 1) % 1023;
+    chip = (chip_start > 0) ? chip_start % CA_CODE_LENGTH : 0;
 }
 
-uint8_t WAASCodeGenerator::get_chip()
+WAASCodeGenerator::WAASCodeGenerator(int g2_delay, int chip_start)
 {
-    return g1[10] ^ g2[10];
+    table = NULL;
+    for (size_t i = 0; i < WAAS_CODES; i++)
+    {
+        if (waas_code_params[i][1] == g2_delay)
+        {
+            table = waas_code_table(waas_code_params[i][0]);
+            break;
+        }
+    }
+    if (table == NULL)
+    {
+        fprintf(stderr, "No SBAS PRN with G2 delay %o in waas_code_params\n", g2_delay);
+        exit(1);
+    }
+
+    chip = (chip_start > 0) ? chip_start % CA_CODE_LENGTH : 0;
 }
 
 GalileoE1CodeGenerator::GalileoE1CodeGenerator(int code_idx, int chip_start)
@@ -110,25 +118,6 @@ uint8_t GalileoE1CodeGenerator::get_data_chip()
     return (gal_e1b_code[code_idx][chip / 8] >> (7 - (chip % 8))) & 0x1;
 }
 
-double cn0_svn_estimator(const double *ip, const double *qp, int length, double coh_integration_time_s)
-{
-    double SNR = 0.0;
-    double SNR_dB_Hz = 0.0;
-    double Psig = 0.0;
-    double Ptot = 0.0;
-    for (int i = 0; i < length; i++)
-    {
-        Psig += fabs(ip[i]);
-        Ptot += qp[i] * qp[i] + ip[i] * ip[i];
-    }
-    Psig /= static_cast<double>(length);
-    Psig = Psig * Psig;
-    Ptot /= static_cast<double>(length);
-    SNR = Psig / (Ptot - Psig);
-    SNR_dB_Hz = 10.0 * log10(SNR) - 10.0 * log10(coh_integration_time_s);
-    return SNR_dB_Hz;
-}
-
 void bytes_to_number(void *dest, uint8_t *buf, int dest_size, int src_size, uint8_t sign)
 {
     if ((dest_size < src_size) || (dest_size % 8 != 0))
@@ -344,4 +333,161 @@ int viterbi_decode(uint8_t *data, uint8_t *result, int ninput)
     }
 
     return best_ending;
-}
\ No newline at end of file
+}
+
+// Each byte of packed samples expands to 8 unpacked samples
+struct UnpackLUT
+{
+    uint64_t entries[256];
+
+    UnpackLUT()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            entries[i] = 0;
+            for (int j = 0; j < 8; j++)
+            {
+                entries[i] |= (uint64_t)((i >> j) & 0x1) << (8 * j);
+            }
+        }
+    }
+};
+
+static const UnpackLUT unpack_lut;
+
+void unpack_bits(const uint8_t *packed, uint8_t *samples, long long nbytes)
+{
+    for (long long i = 0; i < nbytes; i++)
+    {
+        memcpy(samples + i * 8, &unpack_lut.entries[packed[i]], 8);
+    }
+}
+
+void pack_bits(const uint8_t *samples, uint64_t *words, long long size)
+{
+    long long nwords = (size + 63) / 64;
+    for (long long i = 0; i < nwords; i++)
+    {
+        uint64_t word = 0;
+        long long base = i * 64;
+        for (int j = 0; j < 8; j++)
+        {
+            long long start = base + j * 8;
+            uint64_t bytes = 0;
+            if (start + 8 <= size)
+            {
+                memcpy(&bytes, samples + start, 8);
+            }
+            else if (start < size)
+            {
+                memcpy(&bytes, samples + start, size - start);
+            }
+
+            // Set the low bit of each byte above 0, then gather them into one
+            // byte, first sample in the LSB
+            bytes = ((((bytes & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | bytes) >> 7) & 0x0101010101010101ULL;
+            word |= ((bytes * 0x0102040810204080ULL) >> 56) << (j * 8);
+        }
+        words[i] = word;
+    }
+}
+
+void copy_bits(const uint64_t *src, long long src_pos, uint64_t *dst, long long dst_pos, long long size)
+{
+    while (size > 0)
+    {
+        // Move as many bits as fit in both the source and destination words
+        int src_off = src_pos % 64;
+        int dst_off = dst_pos % 64;
+        long long take = 64 - ((src_off > dst_off) ? src_off : dst_off);
+        if (take > size)
+            take = size;
+
+        uint64_t mask = (take == 64) ? ~0ULL : ((1ULL << take) - 1);
+        uint64_t bits = (src[src_pos / 64] >> src_off) & mask;
+        uint64_t *word = &dst[dst_pos / 64];
+        *word = (*word & ~(mask << dst_off)) | (bits << dst_off);
+
+        src_pos += take;
+        dst_pos += take;
+        size -= take;
+    }
+}
+
+void *aligned_malloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+    {
+        return NULL;
+    }
+    return ptr;
+#endif
+}
+
+void aligned_free(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+#ifdef SIMD_X86
+static void cpuid(int leaf, int subleaf, unsigned int *regs)
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuidex(info, leaf, subleaf);
+    for (int i = 0; i < 4; i++)
+    {
+        regs[i] = (unsigned int)info[i];
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on a context switch
+static uint64_t read_xcr0()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+void get_cpu_features(CpuFeatures *features)
+{
+    features->avx2 = false;
+    features->avx512f = false;
+    features->avx512bw = false;
+    features->avx512_popcnt = false;
+
+#ifdef SIMD_X86
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7)
+        return;
+
+    cpuid(1, 0, regs);
+    bool osxsave = (regs[2] >> 27) & 1;
+    uint64_t xcr0 = osxsave ? read_xcr0() : 0;
+    bool ymm_state = (xcr0 & 0x06) == 0x06;
+    bool zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+    cpuid(7, 0, regs);
+    features->avx2 = ymm_state && ((regs[1] >> 5) & 1);
+    features->avx512f = zmm_state && ((regs[1] >> 16) & 1);
+    features->avx512bw = features->avx512f && ((regs[1] >> 30) & 1);
+    features->avx512_popcnt = features->avx512f && ((regs[2] >> 14) & 1);
+#endif
+}
@@ -8,10 +8,6 @@
 #define CODE_LENGTH 4092
 #define FREQ_E1 1.57542e9
 
-// 1-bit carrier LUTs
-const uint8_t carrier_sin[] = {1, 1, 0, 0};
-const uint8_t carrier_cos[] = {1, 0, 0, 1};
-
 GalileoE1Tracker::GalileoE1Tracker(int sv, double fs, double fc, double doppler, double code_off, double dll_bw, double pll_bw, double fll_bw)
 {
     this->sv = sv;
@@ -36,52 +32,18 @@ GalileoE1Tracker::GalileoE1Tracker(int sv, double fs, double fc, double doppler,
     }
     code_gen = new GalileoE1CodeGenerator(sv - 1, start_chip);
 
-    // Code generator outputs
-    // Figure out the start chip and increment it if we overflowed
-    // the code_phase when we defined it.
-    code_very_early = 0;
-    code_early = 0;
-    code_prompt = 0;
-    code_late = 0;
-    code_very_late = 0;
-
-    code_prompt_data = 0;
-
-    // BOC generator
-    boc1 = 0;
-
-    // Accumulators
-    ive = 0;
-    qve = 0;
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
-    ivl = 0;
-    qvl = 0;
-
-    // Data accumulators
-    ip_data = 0;
-    qp_data = 0;
-
-    // Variable to detect if this epoch has been processed
-    epoch_processed = false;
-
     // DLL filter
-    dll = new SecondOrderPLL(dll_bw, doppler * CHIP_RATE / FREQ_E1);
+    dll = LoopFilter<2>(dll_bw, doppler * CHIP_RATE / FREQ_E1);
 
     // PLL filter
-    pll = new ThirdOrderFLLAssistedPLL(fll_bw, pll_bw, doppler);
+    pll = FLLAssistedPLL<3>(fll_bw, pll_bw, doppler);
 
     ms_elapsed = 0;
 
-    // Prompt buffers
-    memset(ip_buffer, 0, sizeof(ip_buffer));
-    memset(qp_buffer, 0, sizeof(qp_buffer));
-    prompt_len = 0;
-    prompt_idx = 0;
+    // C/N0 estimator and previous prompt
+    cn0_estimator = CN0Estimator<PROMPT_LEN>((double)CODE_LENGTH / CHIP_RATE);
+    prev_ip = 0;
+    prev_qp = 0;
 
     // VE, VL buffers
     vel_p_squared_len = 0;
@@ -115,95 +77,16 @@ GalileoE1Tracker::GalileoE1Tracker(int sv, double fs, double fc, double doppler,
 
 GalileoE1Tracker::~GalileoE1Tracker()
 {
-    delete code_gen;
-    delete dll;
-    delete pll;
-}
-
-// Update the tracker with a new sample
-void GalileoE1Tracker::update_sample(uint8_t signal_sample)
-{
-    // Update the carrier NCO
-    carrier_phase += carrier_rate;
-    if (carrier_phase >= 4)
-    {
-        carrier_phase -= 4;
-    }
-
-    // Get the code chip
-
-    // Early code chip (1/4 chip before P chip)
-    if (code_phase >= 0.5 - half_el_spacing)
-    {
-        code_early = code_very_early;
-    }
-
-    // Prompt code chip (0.5 chip after VE chip)
-    if (code_phase >= 0.5)
-    {
-        code_prompt = code_early;
-        code_prompt_data = code_gen->get_data_chip();
-
-        // Falling edge of BOC1
-        boc1 = 0;
-    }
-
-    // Late code chip (1/4 chip after P chip)
-    if (code_phase >= 0.5 + half_el_spacing)
-    {
-        code_late = code_prompt;
-    }
-
-    // Very early code chip (first to change)
-    // Late code chip (clocked at the same time, but 1 chip behind)
-    if (code_phase >= 1)
-    {
-        // Update very late code from last late chip
-        code_very_late = code_late;
-
-        // Get new early code chip
-        code_gen->clock_chip();
-        code_very_early = code_gen->get_chip();
-
-        code_phase -= 1.0;
-
-        // Rising edge of BOC1
-        boc1 = 1;
-    }
-
-    // Update the code NCO
-    code_phase += code_rate;
-
-    // Get the local oscillator signals
-    uint8_t lo_i = carrier_sin[int(carrier_phase)];
-    uint8_t lo_q = carrier_cos[int(carrier_phase)];
-
-    // Update the accumulators
-    ive += (signal_sample ^ lo_i ^ code_very_early ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    qve += (signal_sample ^ lo_q ^ code_very_early ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    ie += (signal_sample ^ lo_i ^ code_early ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    qe += (signal_sample ^ lo_q ^ code_early ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    ip += (signal_sample ^ lo_i ^ code_prompt ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    qp += (signal_sample ^ lo_q ^ code_prompt ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    il += (signal_sample ^ lo_i ^ code_late ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    ql += (signal_sample ^ lo_q ^ code_late ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    ivl += (signal_sample ^ lo_i ^ code_very_late ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-    qvl += (signal_sample ^ lo_q ^ code_very_late ^ boc1 ^ (pilot_state == E1_PILOT_LOCK_SEC ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0)) ? 1 : -1;
-
-    ip_data += (signal_sample ^ lo_i ^ code_prompt_data ^ boc1) ? 1 : -1;
-    qp_data += (signal_sample ^ lo_q ^ code_prompt_data ^ boc1) ? 1 : -1;
 }
 
 // Update the tracker with a new epoch
 void GalileoE1Tracker::update_epoch()
 {
-    // SNR
-    ip_buffer[prompt_idx] = ip;
-    qp_buffer[prompt_idx] = qp;
-    prompt_len += (prompt_len >= PROMPT_LEN) ? 0 : 1;
-    prompt_idx = (prompt_idx + 1) % PROMPT_LEN;
+    end_epoch();
 
-    cn0 = cn0_svn_estimator(ip_buffer, qp_buffer, prompt_len, (double)CODE_LENGTH / CHIP_RATE);
+    // SNR
+    cn0_estimator.update(acc[IP], acc[QP]);
+    cn0 = cn0_estimator.get_cn0();
 
     // Promotion to fine tracking
     if (cn0 <= 35.0)
@@ -221,11 +104,11 @@ void GalileoE1Tracker::update_epoch()
     // Helps keep lock for weak signals
     if (cn0 >= 27.0)
     {
-        pll->set_bandwidth(25.0, 25.0);
+        pll.set_bandwidth(25.0, 25.0);
     }
     else
     {
-        pll->set_bandwidth(35.0, 35.0);
+        pll.set_bandwidth(35.0, 35.0);
     }
 
     // Pilot tracking state
@@ -256,20 +139,20 @@ void GalileoE1Tracker::update_epoch()
             else
             {
                 memmove(pilot_secondary_acc, pilot_secondary_acc + 1, 24);
-                pilot_secondary_acc[24] = ip > 0 ? 1 : 0;
+                pilot_secondary_acc[24] = acc[IP] > 0 ? 1 : 0;
             }
         }
         else
         {
-            pilot_secondary_acc[pilot_secondary_idx] = ip > 0 ? 1 : 0;
+            pilot_secondary_acc[pilot_secondary_idx] = acc[IP] > 0 ? 1 : 0;
             pilot_secondary_idx++;
         }
     }
 
     // VEL bump jump detection
-    double ve_p_squared = sqrt(ive * ive + qve * qve);
-    double p_p_squared = sqrt(ip * ip + qp * qp);
-    double vl_p_squared = sqrt(ivl * ivl + qvl * qvl);
+    double ve_p_squared = sqrt(acc[IVE] * acc[IVE] + acc[QVE] * acc[QVE]);
+    double p_p_squared = sqrt(acc[IP] * acc[IP] + acc[QP] * acc[QP]);
+    double vl_p_squared = sqrt(acc[IVL] * acc[IVL] + acc[QVL] * acc[QVL]);
 
     // Update the sum by adding this power and subtracting the oldest power
     ve_p_squared_sum += ve_p_squared - ve_p_squared_buffer[vel_p_squared_idx];
@@ -287,43 +170,45 @@ void GalileoE1Tracker::update_epoch()
 
     // Compute the Costas loop discriminator or pure phase discriminator
     double carrier_discriminator = 0;
-    if (ip != 0)
+    if (acc[IP] != 0)
     {
         if (pilot_state == E1_PILOT_LOCK_SEC)
         {
-            carrier_discriminator = atan2((double)qp, (double)ip) / (2.0 * PI);
+            carrier_discriminator = atan2((double)acc[QP], (double)acc[IP]) / (2.0 * PI);
         }
         else
         {
-            carrier_discriminator = atan((double)qp / ip) / (2.0 * PI);
+            carrier_discriminator = atan((double)acc[QP] / acc[IP]) / (2.0 * PI);
         }
     }
 
     // Compute the frequency error
     double carrier_discriminator_fll = 0;
-    if (cn0 < 30.0 && ip != 0 && ip_buffer[(prompt_idx - 2 + PROMPT_LEN) % PROMPT_LEN] != 0)
+    if (cn0 < 30.0 && acc[IP] != 0 && prev_ip != 0)
     {
-        carrier_discriminator_fll = (atan((double)qp / ip) - atan((double)qp_buffer[(prompt_idx - 2 + PROMPT_LEN) % PROMPT_LEN] / ip_buffer[(prompt_idx - 2 + PROMPT_LEN) % PROMPT_LEN]));
+        carrier_discriminator_fll = (atan((double)acc[QP] / acc[IP]) - atan((double)prev_qp / prev_ip));
     }
+    prev_ip = acc[IP];
+    prev_qp = acc[QP];
     carrier_discriminator_fll = PHASE_UNWRAP(carrier_discriminator_fll) / (2.0 * PI * (double)CODE_LENGTH / CHIP_RATE);
 
     // Filter the carrier discriminator
-    double carrier_error = pll->update(carrier_discriminator_fll, carrier_discriminator, (double)CODE_LENGTH / CHIP_RATE); // Hz
+    double carrier_error = pll.update(carrier_discriminator_fll, carrier_discriminator, (double)CODE_LENGTH / CHIP_RATE); // Hz
 
     // Update the carrier NCO
     carrier_rate = (fc + carrier_error) * 4 / fs;
 
     // Compute the normalized very-early-minus-late power discriminator
-    // double power_early = sqrt(ie * ie + qe * qe /* + ive * ive + qve * qve*/);
-    // double power_late = sqrt(il * il + ql * ql /* + ivl * ivl + qvl * qvl*/);
+    // double power_early = sqrt(acc[IE] * acc[IE] + acc[QE] * acc[QE] /* + acc[IVE] * acc[IVE] + acc[QVE] * acc[QVE]*/);
+    // double power_late = sqrt(acc[IL] * acc[IL] + acc[QL] * acc[QL] /* + acc[IVL] * acc[IVL] + acc[QVL] * acc[QVL]*/);
     // double code_discriminator = 0.0;
     // if (power_early + power_late != 0)
     // {
     //     code_discriminator = ((power_early - power_late) / (power_early + power_late)); /* code */
     // }
 
-    double code_discriminator = discriminator_factor * ((ie - il) * ip + (qe - ql) * qp);
-    double code_normalization = (ie + il) * ip + (qe + ql) * qp;
+    double code_discriminator = discriminator_factor * ((acc[IE] - acc[IL]) * acc[IP] + (acc[QE] - acc[QL]) * acc[QP]);
+    double code_normalization = (acc[IE] + acc[IL]) * acc[IP] + (acc[QE] + acc[QL]) * acc[QP];
     if (code_normalization != 0)
     {
         code_discriminator /= code_normalization;
@@ -334,7 +219,7 @@ void GalileoE1Tracker::update_epoch()
     }
 
     // Filter the code discriminator
-    double code_error = dll->update(code_discriminator, (double)CODE_LENGTH / CHIP_RATE); // chips/s
+    double code_error = dll.update(code_discriminator, (double)CODE_LENGTH / CHIP_RATE); // chips/s
 
     // Update the code NCO
     code_rate = (CHIP_RATE + code_error) / fs;
@@ -367,28 +252,16 @@ void GalileoE1Tracker::update_epoch()
     }
 
     // Recover bit
-    nav_buf[nav_count] = ip_data > 0 ? 1 : 0;
+    nav_buf[nav_count] = acc[IP_DATA] > 0 ? 1 : 0;
     nav_count++;
 
-    // printf("%.0f,%.0f,%.0f,%.0f,%.0f,", sqrt(ive * ive + qve * qve), sqrt(ie * ie + qe * qe), sqrt(ip * ip + qp * qp), sqrt(il * il + ql * ql), sqrt(ivl * ivl + qvl * qvl));
+    // printf("%.0f,%.0f,%.0f,%.0f,%.0f,", sqrt(acc[IVE] * acc[IVE] + acc[QVE] * acc[QVE]), sqrt(acc[IE] * acc[IE] + acc[QE] * acc[QE]), sqrt(acc[IP] * acc[IP] + acc[QP] * acc[QP]), sqrt(acc[IL] * acc[IL] + acc[QL] * acc[QL]), sqrt(acc[IVL] * acc[IVL] + acc[QVL] * acc[QVL]));
     // printf("%.8f,%.8f,", code_error, carrier_error);
     // printf("%.8f,%.8f,", code_rate * fs, carrier_rate * fs / 4);
-    // printf("%d,%d,%d,%d,%0.1f\n", ip, qp, ip_data, qp_data, cn0);
+    // printf("%d,%d,%d,%d,%0.1f\n", acc[IP], acc[QP], acc[IP_DATA], acc[QP_DATA], cn0);
 
     // Reset the accumulators
-    ive = 0;
-    qve = 0;
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
-    ivl = 0;
-    qvl = 0;
-
-    ip_data = 0;
-    qp_data = 0;
+    memset(acc, 0, sizeof(acc));
 
     // Set the flag to indicate that this epoch has been processed
     epoch_processed = true;
@@ -396,6 +269,12 @@ void GalileoE1Tracker::update_epoch()
 
     // Update the pilot secondary chip
     pilot_secondary_chip = (pilot_secondary_chip + 1) % 25;
+
+    // Process a page
+    if (nav_count >= 250)
+    {
+        update_nav();
+    }
 }
 
 void GalileoE1Tracker::update_nav()
@@ -497,35 +376,6 @@ void GalileoE1Tracker::update_nav()
     nav_count = 0;
 }
 
-void GalileoE1Tracker::track(uint8_t *signal, long long size)
-{
-    // Per sample loop
-    for (int i = 0; i < size; i++)
-    {
-        update_sample(signal[i]);
-
-        // After accumulating and a new code epoch starts, we can process
-        // the accumulated values to update the tracking lock and bit recovery
-        if (code_gen->chip == 0)
-        {
-            if (!epoch_processed)
-            {
-                // Update the epoch
-                update_epoch();
-                if (nav_count >= 250)
-                {
-                    update_nav();
-                }
-            }
-        }
-        else
-        {
-            // This resets the flag on chips other than 0
-            epoch_processed = false;
-        }
-    }
-}
-
 double GalileoE1Tracker::get_tx_time()
 {
     uint32_t chips = code_gen->chip;
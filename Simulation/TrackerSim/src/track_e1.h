@@ -4,7 +4,9 @@
 #include <stdint.h>
 #include "tools.h"
 #include "filters.h"
+#include "cn0_estimator.h"
 #include "ephm_e1.h"
+#include "tracker_core.h"
 
 #define PROMPT_LEN 100
 #define VEL_LEN 10
@@ -16,7 +18,7 @@ typedef enum
     E1_PILOT_LOCK_SEC = 2,
 } e1_pilot_tracking_state_t;
 
-class GalileoE1Tracker
+class GalileoE1Tracker : public TrackerCore<GalileoE1Tracker, E1Signal>
 {
 public:
     GalileoE1Tracker(
@@ -31,76 +33,57 @@ public:
 
     ~GalileoE1Tracker();
 
-    void track(uint8_t *signal, long long size);
-
     void get_satellite_ecef(double t, double *x, double *y, double *z);
     double get_clock_correction(double t);
     double get_tx_time();
     bool ready_to_solve();
     double get_cn0() { return cn0; }
+    void set_cn0_algorithm(cn0_algorithm_t algorithm) { cn0_estimator.set_algorithm(algorithm); }
     int get_sv() { return sv; }
 
 private:
+    friend class TrackerCore<GalileoE1Tracker, E1Signal>;
+
+    // Accumulators (very early to very late pilot, then prompt data)
+    enum
+    {
+        IVE,
+        QVE,
+        IE,
+        QE,
+        IP,
+        QP,
+        IL,
+        QL,
+        IVL,
+        QVL,
+        IP_DATA,
+        QP_DATA
+    };
+
     int sv;
     double fs;
     double fc;
     double doppler;
     double code_off;
 
-    // NCOs
-    double code_phase;
-    double code_rate;
-    double carrier_phase;
-    double carrier_rate;
-
     // Code generator
     int start_chip;
-    GalileoE1CodeGenerator *code_gen;
-
-    // Code generator outputs
-    uint8_t code_very_early;
-    uint8_t code_early;
-    uint8_t code_prompt;
-    uint8_t code_late;
-    uint8_t code_very_late;
-
-    uint8_t code_prompt_data;
-
-    // BOC generator
-    uint8_t boc1;
-
-    // Accumulators (very early, early, prompt, late, very late for I and Q)
-    int ive;
-    int qve;
-    int ie;
-    int qe;
-    int ip;
-    int qp;
-    int il;
-    int ql;
-    int ivl;
-    int qvl;
-
-    // Data accumulators
-    int ip_data;
-    int qp_data;
-
-    // Variable to detect if this epoch has been processed
-    bool epoch_processed;
 
     // DLL filter
-    PLL *dll;
+    LoopFilter<2> dll;
 
     // PLL filter
-    PLL *pll;
+    FLLAssistedPLL<3> pll;
 
     long long ms_elapsed;
 
-    // Prompt buffers
-    double ip_buffer[PROMPT_LEN];
-    double qp_buffer[PROMPT_LEN];
-    int prompt_len;
-    int prompt_idx;
+    // C/N0 over the last PROMPT_LEN prompt sums
+    CN0Estimator<PROMPT_LEN> cn0_estimator;
+
+    // Previous prompt sums, for the FLL discriminator
+    int prev_ip;
+    int prev_qp;
 
     // VE, VL buffers
     double ve_p_squared_buffer[VEL_LEN];
@@ -112,8 +95,7 @@ private:
     int vel_p_squared_len;
     int vel_p_squared_idx;
 
-    // Code tracking adjustments
-    double half_el_spacing;
+    // Code tracking adjustments (and half_el_spacing)
     double discriminator_factor;
 
     // Pilot tracking
@@ -138,8 +120,13 @@ private:
     // SNR
     double cn0;
 
+    // Secondary chip of the pilot taps, 0 until it is locked
+    uint8_t secondary_chip()
+    {
+        return (pilot_state == E1_PILOT_LOCK_SEC) ? e1_secondary[pilot_secondary_chip] ^ pilot_secondary_pol : 0;
+    }
+
     // Private functions
-    void update_sample(uint8_t signal_sample);
     void update_epoch();
     void update_nav();
 };
@@ -11,10 +11,6 @@
 #define BIT_SYNC_THRESHOLD 35.0
 #define BIT_SYNC_MS 1000
 
-// 1-bit carrier LUTs
-const uint8_t carrier_sin[] = {1, 1, 0, 0};
-const uint8_t carrier_cos[] = {1, 0, 0, 1};
-
 uint8_t check_parity(uint8_t *bits, uint8_t *p, uint8_t D29, uint8_t D30);
 
 GPSL1CATracker::GPSL1CATracker(int sv, double fs, double fc, double doppler, double code_off)
@@ -41,36 +37,36 @@ GPSL1CATracker::GPSL1CATracker(int sv, double fs, double fc, double doppler, dou
     }
     code_gen = new CACodeGenerator(l1_taps[sv - 1][0], l1_taps[sv - 1][1], start_chip);
 
-    // Code generator outputs
-    // Figure out the start chip and increment it if we overflowed
-    // the code_phase when we defined it.
-    code_early = 0;
-    code_prompt = 0;
-    code_late = 0;
-
-    // Accumulators
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
-
-    // Variable to detect if this epoch has been processed
-    epoch_processed = false;
+    // Integer NCOs
+    integer_nco = false;
+    code_nco = 0;
+    code_fcw = 0;
+    lo_nco = 0;
+    lo_fcw = 0;
+    drop_sample = false;
+
+    // Cached replicas
+    replica_cache = NULL;
+    for (int i = 0; i < 3; i++)
+    {
+        replicas[i] = NULL;
+        replica_pos[i] = 0;
+    }
+    replica_start = 0;
+    epoch_sample = 0;
+    epoch_samples = 0;
 
     // DLL filter
-    dll = new SecondOrderPLL(5.0, doppler * CHIP_RATE / FREQ_L1CA);
+    dll = LoopFilter<2>(5.0, doppler * CHIP_RATE / FREQ_L1CA);
 
     // PLL filter
-    pll = new ThirdOrderPLL(50.0, doppler);
+    pll = LoopFilter<3>(50.0, doppler);
 
     // Time
     ms_elapsed = 0;
 
-    // Prompt buffers
-    prompt_len = 0;
-    prompt_idx = 0;
+    // C/N0 estimator
+    cn0_estimator = CN0Estimator<100>(0.001);
 
     // Bit sync
     last_ip = 0;
@@ -93,93 +89,445 @@ GPSL1CATracker::GPSL1CATracker(int sv, double fs, double fc, double doppler, dou
 
 GPSL1CATracker::~GPSL1CATracker()
 {
-    delete code_gen;
-    delete dll;
-    delete pll;
+    release_replicas();
 }
 
 // Update the tracker with a new sample
 void GPSL1CATracker::update_sample(uint8_t signal_sample)
 {
-    // Get the local oscillator signals
-    uint8_t lo_i = carrier_sin[int(carrier_phase)];
-    uint8_t lo_q = carrier_cos[int(carrier_phase)];
+    if (integer_nco)
+    {
+        update_sample_fixed(signal_sample);
+        return;
+    }
+    TrackerCore::update_sample(signal_sample);
+}
 
-    // Update the carrier NCO
-    carrier_phase += carrier_rate;
-    if (carrier_phase >= 4)
+// Update the tracker with a new sample using the integer NCOs. As in the
+// RTL, the sample correlates with the current chips and carrier, then the
+// NCOs step. A code phase overflow clocks the early chip and any change of
+// bit 31 (every half chip) shifts early into prompt and prompt into late,
+// both taking effect from the next sample. The RTL clears its accumulators
+// on the first sample of chip 0 instead of accumulating it, so that sample
+// goes into neither epoch.
+void GPSL1CATracker::update_sample_fixed(uint8_t signal_sample)
+{
+    // Carrier LUT index from the top two phase bits
+    uint8_t lo_i = carrier_sin[lo_nco >> 30];
+    uint8_t lo_q = carrier_cos[lo_nco >> 30];
+    lo_nco += lo_fcw;
+
+    // Update the accumulators
+    if (drop_sample)
+    {
+        drop_sample = false;
+    }
+    else
     {
-        carrier_phase -= 4;
+        for (int t = EARLY; t <= LATE; t++)
+        {
+            acc[2 * t] += (signal_sample ^ lo_i ^ code_chips[t]) ? 1 : -1;
+            acc[2 * t + 1] += (signal_sample ^ lo_q ^ code_chips[t]) ? 1 : -1;
+        }
     }
 
-    // Get the code chip
+    // Code NCO strobes
+    uint32_t next = code_nco + code_fcw;
+    if ((next ^ code_nco) >> 31)
+    {
+        code_chips[LATE] = code_chips[PROMPT];
+        code_chips[PROMPT] = code_chips[EARLY];
+    }
+    if (next < code_nco)
+    {
+        code_gen->clock_chip();
+        code_chips[EARLY] = code_gen->get_chip();
+        drop_sample = (code_gen->chip == 0);
+    }
+    code_nco = next;
+}
+
+void GPSL1CATracker::set_replica_cache(ReplicaCache *cache)
+{
+    release_replicas();
+    replica_cache = cache;
+
+    // Start the first epoch where the code NCO is
+    replica_start = code_gen->chip + code_phase;
+}
+
+void GPSL1CATracker::release_replicas()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (replicas[i] != NULL)
+        {
+            replica_cache->release(replicas[i]);
+            replicas[i] = NULL;
+        }
+    }
+}
+
+// Replicas for the epoch starting at replica_start. The prompt and late
+// chips trail the early chip by a half and a whole chip.
+void GPSL1CATracker::start_replicas()
+{
+    double starts[3] = {replica_start, replica_start - 0.5, replica_start - 1.0};
+    for (int i = 0; i < 3; i++)
+    {
+        replicas[i] = replica_cache->acquire(REPLICA_GPS_CA, sv, code_rate * fs, starts[i], &replica_pos[i]);
+    }
+
+    // The epoch ends on the sample where the early chip returns to chip 0
+    epoch_samples = (long long)ceil((CODE_LENGTH - replica_start) / code_rate) + 1;
+    epoch_sample = 0;
+}
+
+// Step the carrier NCO over n samples (at most 64) as update_sample() does,
+// returning its replica words
+void GPSL1CATracker::carrier_word(int n, uint64_t *lo_i, uint64_t *lo_q)
+{
+    uint64_t phases[2] = {0, 0};
+    int count[2] = {0, 0};
+    double carrier = carrier_phase;
+    double carrier_step = carrier_rate;
+
+    int j = 0;
+    for (int half = 0; half < 2 && j < n; half++)
+    {
+        uint64_t acc = 0;
+        int end = (n < 32 * (half + 1)) ? n : 32 * (half + 1);
+        for (; j < end; j++)
+        {
+            acc = (acc >> 2) | ((uint64_t)int(carrier) << 62);
+            carrier += carrier_step;
+            if (carrier >= 4)
+            {
+                carrier -= 4;
+            }
+        }
+        phases[half] = acc;
+        count[half] = end - 32 * half;
+    }
+
+    carrier_words(phases, count, lo_i, lo_q);
+    carrier_phase = carrier;
+}
+
+// Correlate a word of n packed samples against code replicas sliced from
+// the cache. Only the carrier NCO steps per sample.
+void GPSL1CATracker::update_word_cached(uint64_t signal, int n)
+{
+    int first = 0;
+    while (first < n)
+    {
+        if (replicas[0] == NULL)
+        {
+            start_replicas();
+        }
+
+        int count = n - first;
+        if (count > epoch_samples - epoch_sample)
+        {
+            count = (int)(epoch_samples - epoch_sample);
+        }
+
+        uint64_t lo_i;
+        uint64_t lo_q;
+        carrier_word(count, &lo_i, &lo_q);
+        uint64_t code[3];
+        for (int t = EARLY; t <= LATE; t++)
+        {
+            code[t] = ReplicaCache::slice(replicas[t], replica_pos[t] + epoch_sample);
+        }
+        uint64_t mask = (count == 64) ? ~0ULL : ((1ULL << count) - 1);
+        accumulate_word(signal >> first, lo_i, lo_q, code, 0, mask);
+
+        first += count;
+        epoch_sample += count;
+        if (epoch_sample == epoch_samples)
+        {
+            // Carry the code phase past chip 0 into the next epoch
+            replica_start += epoch_samples * code_rate - CODE_LENGTH;
+            release_replicas();
+            code_gen->chip = 0;
+            code_phase = replica_start;
+            update_epoch();
+            epoch_sample = 0;
+        }
+    }
+
+    // Code NCO state for get_tx_time()
+    double position = replica_start + epoch_sample * code_rate;
+    code_gen->chip = (int)position % CODE_LENGTH;
+    code_phase = position - floor(position);
+}
+
+void GPSL1CATracker::set_integer_nco(bool enable)
+{
+    integer_nco = enable;
+    if (enable)
+    {
+        code_nco = (uint32_t)llround(code_phase * 4294967296.0);
+        lo_nco = (uint32_t)llround(carrier_phase * 1073741824.0);
+        load_fcw();
+        drop_sample = false;
+
+        // The RTL only signals an epoch when the code returns to chip 0
+        epoch_processed = true;
+    }
+}
+
+// Round the loop filter rates to control words. The rates are frequencies
+// over fs, scaled by powers of two, so this rounds f * 2^32 / fs just as
+// Scripts/nco_generate.py does.
+void GPSL1CATracker::load_fcw()
+{
+    code_fcw = (uint32_t)llround(code_rate * 4294967296.0);
+    lo_fcw = (uint32_t)llround(carrier_rate * 1073741824.0);
+}
+
+// Mirror the integer NCO phases in the double state for get_tx_time()
+void GPSL1CATracker::sync_nco_phase()
+{
+    code_phase = code_nco / 4294967296.0;
+    carrier_phase = lo_nco / 1073741824.0;
+}
+
+// Correlate a word of n packed samples using the integer NCOs. The chips
+// only change where the code phase crosses a half chip, and the sample
+// that crosses is found by division, so the code replica is filled in runs
+// with no per-sample work. The carrier bits come straight from the top two
+// phase bits: carrier_sin is NOT bit 31 and carrier_cos is NOT (bit 31 XOR
+// bit 30). As in update_sample_fixed(), the first sample of chip 0 is
+// dropped.
+void GPSL1CATracker::update_word_fixed(uint64_t signal, int n)
+{
+    uint64_t b1 = 0;
+    uint64_t b0 = 0;
+    uint64_t code[3] = {0, 0, 0};
+    int first = 0;         // First sample not yet accumulated
+    uint64_t keep = ~0ULL; // Samples to accumulate
+    if (drop_sample)
+    {
+        keep = ~1ULL;
+        drop_sample = false;
+    }
 
-    // Early code chip (first to change)
-    // Late code chip (clocked at the same time, but 1 chip behind)
-    if (code_phase >= 1)
+    int j = 0;
+    while (j < n)
     {
-        // Update late code from last prompt chip
-        code_late = code_prompt;
+        // Samples with the current chips, up to the one whose step crosses
+        // the next half chip
+        uint64_t to_half = 0x80000000ULL - (code_nco & 0x7FFFFFFF);
+        uint64_t steps = (code_fcw > 0) ? (to_half + code_fcw - 1) / code_fcw : ~0ULL;
+        bool strobe = (steps <= (uint64_t)(n - j));
+        int end = strobe ? j + (int)steps : n;
+
+        uint32_t lo = lo_nco;
+        for (int k = j; k < end; k++)
+        {
+            b1 |= (uint64_t)(lo >> 31) << k;
+            b0 |= (uint64_t)((lo >> 30) & 1) << k;
+            lo += lo_fcw;
+        }
+        lo_nco = lo;
+
+        for (int t = EARLY; t <= LATE; t++)
+        {
+            code[t] = fill_bits(code[t], code_chips[t], j, end);
+        }
+        uint32_t next = code_nco + (uint32_t)(end - j) * code_fcw;
+        j = end;
+
+        if (!strobe)
+        {
+            code_nco = next;
+            break;
+        }
+
+        code_chips[LATE] = code_chips[PROMPT];
+        code_chips[PROMPT] = code_chips[EARLY];
+        bool overflow = (next >> 31) == 0;
+        code_nco = next;
+        if (!overflow)
+            continue;
 
-        // Get new early code chip
         code_gen->clock_chip();
-        code_early = code_gen->get_chip();
+        code_chips[EARLY] = code_gen->get_chip();
+        if (code_gen->chip != 0)
+        {
+            epoch_processed = false;
+            continue;
+        }
 
-        code_phase -= 1.0;
+        // Sample j is the first of chip 0, which the RTL clears its
+        // accumulators on instead of accumulating
+        if (j < n)
+        {
+            keep &= ~(1ULL << j);
+        }
+        else
+        {
+            drop_sample = true;
+        }
+        if (!epoch_processed)
+        {
+            // The epoch falls before sample j
+            uint64_t mask = (~0ULL >> (64 - j)) & ~((1ULL << first) - 1) & keep;
+            accumulate_word(signal, ~b1, ~(b1 ^ b0), code, 0, mask);
+            first = j;
+
+            update_epoch();
+        }
     }
 
-    // Prompt code chip (half chip after early chip)
-    if (code_phase >= 0.5)
+    if (first < n)
     {
-        code_prompt = code_early;
+        uint64_t mask = (~0ULL >> (64 - n)) & ~((1ULL << first) - 1) & keep;
+        accumulate_word(signal, ~b1, ~(b1 ^ b0), code, 0, mask);
     }
+}
 
-    // Update the code NCO
-    code_phase += code_rate;
+bool GPSL1CATracker::check_integer_nco()
+{
+    // From Scripts/l1ca_channel_vector.py: PRN 1, doppler 1000 Hz, chip
+    // 1020, the IE, QE, IP, QP, IL and QL of the first three epochs
+    static const int expected[3][6] = {
+        {16, -20, 16, -20, 16, -20},
+        {156, 176, 618, 154, 354, 2},
+        {-119, 87, -241, 109, 121, 171},
+    };
+    const double fs = 69.984e6;
+    const double fc = 9.334875e6;
+    const double doppler = 1000.0;
+
+    bool ok = true;
+    for (int words = 0; words < 2; words++)
+    {
+        GPSL1CATracker *tracker = new GPSL1CATracker(1, fs, fc, doppler, 1020.0);
+        tracker->set_integer_nco(true);
+
+        // Zero bandwidth loops hold the control words of the vector, and the
+        // model starts with prompt and late at 0
+        tracker->dll = LoopFilter<2>(0, doppler * CHIP_RATE / FREQ_L1CA);
+        tracker->pll = LoopFilter<3>(0, doppler);
+        tracker->code_chips[EARLY] = tracker->code_gen->get_chip();
+        tracker->code_chips[PROMPT] = 0;
+        tracker->code_chips[LATE] = 0;
+        ok = ok && tracker->code_fcw == 62782269 && tracker->lo_fcw == 572949214;
+
+        // The same LCG input as the model, the word path is checked on the
+        // prompt I it leaves in last_ip
+        uint32_t lcg = 1;
+        int epoch = 0;
+        while (ok && epoch < 3)
+        {
+            if (words)
+            {
+                uint64_t word = 0;
+                for (int k = 0; k < 64; k++)
+                {
+                    lcg = lcg * 1103515245u + 12345u;
+                    word |= (uint64_t)(lcg >> 31) << k;
+                }
+                long long ms = tracker->ms_elapsed;
+                tracker->update_word_fixed(word, 64);
+                if (tracker->ms_elapsed != ms)
+                {
+                    ok = (tracker->last_ip == expected[epoch][IP]);
+                    epoch++;
+                }
+                continue;
+            }
 
-    // Update the accumulators
-    ie += (signal_sample ^ lo_i ^ code_early) ? 1 : -1;
-    qe += (signal_sample ^ lo_q ^ code_early) ? 1 : -1;
-    ip += (signal_sample ^ lo_i ^ code_prompt) ? 1 : -1;
-    qp += (signal_sample ^ lo_q ^ code_prompt) ? 1 : -1;
-    il += (signal_sample ^ lo_i ^ code_late) ? 1 : -1;
-    ql += (signal_sample ^ lo_q ^ code_late) ? 1 : -1;
+            lcg = lcg * 1103515245u + 12345u;
+            tracker->update_sample_fixed((uint8_t)(lcg >> 31));
+            if (tracker->code_gen->chip != 0)
+            {
+                tracker->epoch_processed = false;
+            }
+            else if (!tracker->epoch_processed)
+            {
+                ok = (memcmp(tracker->acc, expected[epoch], sizeof(expected[epoch])) == 0);
+                tracker->update_epoch();
+                epoch++;
+            }
+        }
+        delete tracker;
+    }
+    return ok;
+}
+
+void GPSL1CATracker::get_channel_state(L1CAChannelState *state)
+{
+    state->code_phase = code_phase;
+    state->code_rate = code_rate;
+    state->carrier_phase = carrier_phase;
+    state->carrier_rate = carrier_rate;
+    state->chip = code_gen->chip;
+    state->code_early = code_chips[EARLY];
+    state->code_prompt = code_chips[PROMPT];
+    state->code_late = code_chips[LATE];
+    state->epoch_processed = epoch_processed;
+}
+
+void GPSL1CATracker::set_channel_state(const L1CAChannelState *state)
+{
+    code_phase = state->code_phase;
+    code_rate = state->code_rate;
+    carrier_phase = state->carrier_phase;
+    carrier_rate = state->carrier_rate;
+    code_chips[EARLY] = state->code_early;
+    code_chips[PROMPT] = state->code_prompt;
+    code_chips[LATE] = state->code_late;
+    epoch_processed = state->epoch_processed;
+
+    code_gen->chip = state->chip;
+}
+
+void GPSL1CATracker::process_epoch(const int *sums)
+{
+    memcpy(acc, sums, sizeof(acc));
+    update_epoch();
 }
 
 // Update the tracker with a new epoch
 void GPSL1CATracker::update_epoch()
 {
-    // SNR
-    ip_buffer[prompt_idx] = ip;
-    qp_buffer[prompt_idx] = qp;
-    prompt_len += (prompt_len >= 100) ? 0 : 1;
-    prompt_idx = (prompt_idx + 1) % 100;
+    end_epoch();
 
-    cn0 = cn0_svn_estimator(ip_buffer, qp_buffer, 100, 0.001);
+    // SNR
+    cn0_estimator.update(acc[IP], acc[QP]);
+    cn0 = cn0_estimator.get_cn0();
 
     // Compute the Costas loop discriminator
     double carrier_discriminator = 0;
-    if (ip != 0)
+    if (acc[IP] != 0)
     {
-        carrier_discriminator = atan((double)qp / ip) / (2.0 * PI);
+        carrier_discriminator = atan((double)acc[QP] / acc[IP]) / (2.0 * PI);
     }
 
     // Filter the carrier discriminator
-    double carrier_error = pll->update(carrier_discriminator, 0.001); // Hz
+    double carrier_error = pll.update(carrier_discriminator, 0.001); // Hz
 
     // Update the carrier NCO
     carrier_rate = (fc + carrier_error) * 4 / fs;
 
     // Compute the normalized early-minus late power discriminator
-    double power_early = sqrt(ie * ie + qe * qe);
-    double power_late = sqrt(il * il + ql * ql);
+    double power_early = sqrt(acc[IE] * acc[IE] + acc[QE] * acc[QE]);
+    double power_late = sqrt(acc[IL] * acc[IL] + acc[QL] * acc[QL]);
     double code_discriminator = 0.5 * ((power_early - power_late) / (power_early + power_late));
 
     // Filter the code discriminator
-    double code_error = dll->update(code_discriminator, 0.001); // chips/s
+    double code_error = dll.update(code_discriminator, 0.001); // chips/s
 
     // Update the code NCO
     code_rate = (CHIP_RATE + code_error) / fs;
+    if (integer_nco)
+    {
+        load_fcw();
+    }
 
     // Bit sync and bit recovery
     if (bit_synced)
@@ -191,10 +539,10 @@ void GPSL1CATracker::update_epoch()
             nav_count++;
             bit_sum = 0;
         }
-        bit_sum += ip;
+        bit_sum += acc[IP];
     }
-    // Start bit sync when above threshold
-    else if (cn0 > BIT_SYNC_THRESHOLD || bit_sync_count != 0)
+    // Start bit sync when above threshold over a full C/N0 window
+    else if ((cn0 > BIT_SYNC_THRESHOLD && cn0_estimator.full()) || bit_sync_count != 0)
     {
         if (bit_sync_count >= BIT_SYNC_MS)
         {
@@ -217,7 +565,7 @@ void GPSL1CATracker::update_epoch()
                 bit_ms += 20;
         }
         // Update the bit sync histogram
-        bit_hist[bit_ms % 20] += ((ip > 0) != (last_ip > 0)) ? 1 : 0;
+        bit_hist[bit_ms % 20] += ((acc[IP] > 0) != (last_ip > 0)) ? 1 : 0;
         bit_sync_count++;
     }
 
@@ -231,13 +579,8 @@ void GPSL1CATracker::update_epoch()
     }
 
     // Reset the accumulators
-    last_ip = ip;
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
+    last_ip = acc[IP];
+    memset(acc, 0, sizeof(acc));
 
     // Set the flag to indicate that this epoch has been processed
     epoch_processed = true;
@@ -307,30 +650,57 @@ void GPSL1CATracker::update_nav()
     return;
 }
 
-void GPSL1CATracker::track(uint8_t *signal, long long size)
+// Samples that can run before the next code epoch without checking for
+// it, exact for the integer NCOs
+long long GPSL1CATracker::samples_to_epoch()
+{
+    if (!integer_nco)
+        return TrackerCore::samples_to_epoch();
+
+    // An epoch waiting on chip 0 is processed on the next check
+    if ((code_gen->chip == 0 && !epoch_processed) || code_rate <= 0 || code_fcw == 0)
+        return 0;
+
+    // The last clock comes on the step that overflows for the chips-th time
+    int chips = CODE_LENGTH - code_gen->chip;
+    uint64_t total = ((uint64_t)chips << 32) - code_nco;
+    return (long long)((total + code_fcw - 1) / code_fcw) - 1;
+}
+
+void GPSL1CATracker::track(const uint8_t *signal, long long size)
 {
+    TrackerCore::track(signal, size);
 
-    // Per sample loop
-    for (int i = 0; i < size; i++)
+    if (integer_nco)
     {
-        update_sample(signal[i]);
+        sync_nco_phase();
+    }
+}
 
-        // After accumulating and a new code epoch starts, we can process
-        // the accumulated values to update the tracking lock and bit recovery
-        if (code_gen->chip == 0)
+void GPSL1CATracker::track_packed(const uint64_t *words, long long size)
+{
+    for (long long pos = 0; pos < size; pos += 64)
+    {
+        int n = (size - pos < 64) ? (int)(size - pos) : 64;
+        if (integer_nco)
         {
-            if (!epoch_processed)
-            {
-                // Update the epoch
-                update_epoch();
-            }
+            update_word_fixed(words[pos / 64], n);
+        }
+        else if (replica_cache != NULL)
+        {
+            update_word_cached(words[pos / 64], n);
         }
         else
         {
-            // This resets the flag on chips other than 0
-            epoch_processed = false;
+            update_word(words[pos / 64], n);
         }
     }
+    flush_correlator();
+
+    if (integer_nco)
+    {
+        sync_nco_phase();
+    }
 }
 
 double GPSL1CATracker::get_tx_time()
@@ -4,9 +4,26 @@
 #include <stdint.h>
 #include "tools.h"
 #include "filters.h"
+#include "cn0_estimator.h"
 #include "ephm_l1ca.h"
+#include "replica_cache.h"
+#include "tracker_core.h"
 
-class GPSL1CATracker
+// Sample-rate state of a channel, as a ChannelBank runs it
+struct L1CAChannelState
+{
+    double code_phase;
+    double code_rate;
+    double carrier_phase;
+    double carrier_rate;
+    int chip;
+    uint8_t code_early;
+    uint8_t code_prompt;
+    uint8_t code_late;
+    bool epoch_processed;
+};
+
+class GPSL1CATracker : public TrackerCore<GPSL1CATracker, L1CASignal>
 {
 public:
     GPSL1CATracker(
@@ -18,62 +35,100 @@ public:
 
     ~GPSL1CATracker();
 
-    void track(uint8_t *signal, long long size);
+    void track(const uint8_t *signal, long long size);
+    // LSB-first packed samples, correlated 64 at a time. The size need not
+    // be a multiple of 64: the last word then holds size % 64 samples and
+    // is correlated on its own, and the NCOs, chips, accumulators and a
+    // pending integer NCO sample drop carry into the next call, so blocks
+    // of any size track as one.
+    void track_packed(const uint64_t *words, long long size);
+    // Slice the bit-sliced code replicas from a shared cache instead of
+    // stepping the code NCO per sample. Replica timing is then rounded to
+    // the cache's steps, so the output is close to but not identical with
+    // the exact path. Set before tracking, NULL for the exact path.
+    void set_replica_cache(ReplicaCache *cache);
+    // Step the NCOs as RTL/source/l1ca_channel.sv does: 32-bit phase
+    // accumulators, with the loop filter rates rounded to frequency control
+    // words as in Scripts/nco_generate.py. Set before tracking. Applies to
+    // the 1-bit input and takes precedence over the replica cache.
+    void set_integer_nco(bool enable);
+    // Run both integer NCO paths on the vector from
+    // Scripts/l1ca_channel_vector.py, a cycle model of the RTL channel, and
+    // compare the accumulators of each epoch
+    static bool check_integer_nco();
+
+    // For a ChannelBank, which runs the NCOs and correlators of the exact
+    // path itself: hand the sample-rate state over and back, and update the
+    // loops from an epoch's early, prompt and late I/Q sums
+    void get_channel_state(L1CAChannelState *state);
+    void set_channel_state(const L1CAChannelState *state);
+    void process_epoch(const int *sums);
 
     double get_tx_time();
     void get_satellite_ecef(double t, double *x, double *y, double *z);
     double get_clock_correction(double t);
     bool ready_to_solve();
     double get_cn0() { return cn0; }
+    void set_cn0_algorithm(cn0_algorithm_t algorithm) { cn0_estimator.set_algorithm(algorithm); }
     int get_sv() { return sv; }
 
 private:
+    friend class TrackerCore<GPSL1CATracker, L1CASignal>;
+
+    // Code chips and accumulators
+    enum
+    {
+        EARLY,
+        PROMPT,
+        LATE
+    };
+    enum
+    {
+        IE,
+        QE,
+        IP,
+        QP,
+        IL,
+        QL
+    };
+
     int sv;
     double fs;
     double fc;
     double doppler;
     double code_off;
 
-    // NCOs
-    double code_phase;
-    double code_rate;
-    double carrier_phase;
-    double carrier_rate;
-
     // Code generator
     int start_chip;
-    CACodeGenerator *code_gen;
 
-    // Code generator outputs
-    uint8_t code_early;
-    uint8_t code_prompt;
-    uint8_t code_late;
-
-    // Accumulators (early, prompt, late for I and Q)
-    int ie;
-    int qe;
-    int ip;
-    int qp;
-    int il;
-    int ql;
-
-    // Variable to detect if this epoch has been processed
-    bool epoch_processed;
+    // Integer NCOs as in the l1ca_channel RTL, 2^32 is one chip or one
+    // carrier cycle
+    bool integer_nco;
+    uint32_t code_nco;
+    uint32_t code_fcw;
+    uint32_t lo_nco;
+    uint32_t lo_fcw;
+    bool drop_sample; // Next sample is the first of chip 0, which the RTL drops
+
+    // Cached replicas (early, prompt, late) for the current epoch
+    ReplicaCache *replica_cache;
+    const CodeReplica *replicas[3];
+    long long replica_pos[3];  // Sample of each replica at the epoch start
+    double replica_start;      // Early code phase at the epoch start, chips
+    long long epoch_sample;    // Samples into the epoch
+    long long epoch_samples;   // Samples in the epoch
 
     // DLL filter
-    PLL *dll;
+    LoopFilter<2> dll;
 
     // PLL filter
-    PLL *pll;
+    LoopFilter<3> pll;
 
     // Time
     long long ms_elapsed;
 
-    // Prompt buffers
-    double ip_buffer[100];
-    double qp_buffer[100];
-    int prompt_len;
-    int prompt_idx;
+    // C/N0 over the last 100 prompt sums
+    CN0Estimator<100> cn0_estimator;
 
     // Bit sync
     int last_ip;
@@ -98,9 +153,17 @@ private:
     double cn0;
 
     // Private functions
-    void
-    update_sample(uint8_t signal_sample);
+    void update_sample(uint8_t signal_sample);
+    void update_word_cached(uint64_t signal, int n);
+    void update_sample_fixed(uint8_t signal_sample);
+    void update_word_fixed(uint64_t signal, int n);
+    void load_fcw();
+    void sync_nco_phase();
+    void carrier_word(int n, uint64_t *lo_i, uint64_t *lo_q);
+    void start_replicas();
+    void release_replicas();
     void update_epoch();
+    long long samples_to_epoch();
     void update_nav();
 };
 
@@ -12,10 +12,6 @@
 #define BIT_SYNC_THRESHOLD 35.0
 #define BIT_SYNC_MS 1000
 
-// 1-bit carrier LUTs
-const uint8_t carrier_sin[] = {1, 1, 0, 0};
-const uint8_t carrier_cos[] = {1, 0, 0, 1};
-
 uint8_t check_parity(uint8_t *bits, uint8_t *p, uint8_t D29, uint8_t D30);
 
 SBASWAASTracker::SBASWAASTracker(int sv, double fs, double fc, double doppler, double code_off)
@@ -61,36 +57,17 @@ SBASWAASTracker::SBASWAASTracker(int sv, double fs, double fc, double doppler, d
 
     code_gen = new WAASCodeGenerator(g2_delay, start_chip);
 
-    // Code generator outputs
-    // Figure out the start chip and increment it if we overflowed
-    // the code_phase when we defined it.
-    code_early = 0;
-    code_prompt = 0;
-    code_late = 0;
-
-    // Accumulators
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
-
-    // Variable to detect if this epoch has been processed
-    epoch_processed = false;
-
     // DLL filter
-    dll = new SecondOrderPLL(5.0, doppler * CHIP_RATE / FREQ_L1CA);
+    dll = LoopFilter<2>(5.0, doppler * CHIP_RATE / FREQ_L1CA);
 
     // PLL filter
-    pll = new ThirdOrderPLL(50.0, doppler);
+    pll = LoopFilter<3>(50.0, doppler);
 
     // Time
     ms_elapsed = 0;
 
-    // Prompt buffers
-    prompt_len = 0;
-    prompt_idx = 0;
+    // C/N0 estimator
+    cn0_estimator = CN0Estimator<100>(0.001);
 
     // Bit sync
     last_ip = 0;
@@ -113,90 +90,37 @@ SBASWAASTracker::SBASWAASTracker(int sv, double fs, double fc, double doppler, d
 
 SBASWAASTracker::~SBASWAASTracker()
 {
-    delete code_gen;
-    delete dll;
-    delete pll;
-}
-
-// Update the tracker with a new sample
-void SBASWAASTracker::update_sample(uint8_t signal_sample)
-{
-    // Get the local oscillator signals
-    uint8_t lo_i = carrier_sin[int(carrier_phase)];
-    uint8_t lo_q = carrier_cos[int(carrier_phase)];
-
-    // Update the carrier NCO
-    carrier_phase += carrier_rate;
-    if (carrier_phase >= 4)
-    {
-        carrier_phase -= 4;
-    }
-
-    // Get the code chip
-
-    // Early code chip (first to change)
-    // Late code chip (clocked at the same time, but 1 chip behind)
-    if (code_phase >= 1)
-    {
-        // Update late code from last prompt chip
-        code_late = code_prompt;
-
-        // Get new early code chip
-        code_gen->clock_chip();
-        code_early = code_gen->get_chip();
-
-        code_phase -= 1.0;
-    }
-
-    // Prompt code chip (half chip after early chip)
-    if (code_phase >= 0.5)
-    {
-        code_prompt = code_early;
-    }
-
-    // Update the code NCO
-    code_phase += code_rate;
-
-    // Update the accumulators
-    ie += (signal_sample ^ lo_i ^ code_early) ? 1 : -1;
-    qe += (signal_sample ^ lo_q ^ code_early) ? 1 : -1;
-    ip += (signal_sample ^ lo_i ^ code_prompt) ? 1 : -1;
-    qp += (signal_sample ^ lo_q ^ code_prompt) ? 1 : -1;
-    il += (signal_sample ^ lo_i ^ code_late) ? 1 : -1;
-    ql += (signal_sample ^ lo_q ^ code_late) ? 1 : -1;
 }
 
 // Update the tracker with a new epoch
 void SBASWAASTracker::update_epoch()
 {
-    // SNR
-    ip_buffer[prompt_idx] = ip;
-    qp_buffer[prompt_idx] = qp;
-    prompt_len += (prompt_len >= 100) ? 0 : 1;
-    prompt_idx = (prompt_idx + 1) % 100;
+    end_epoch();
 
-    cn0 = cn0_svn_estimator(ip_buffer, qp_buffer, 100, 0.001);
+    // SNR
+    cn0_estimator.update(acc[IP], acc[QP]);
+    cn0 = cn0_estimator.get_cn0();
 
     // Compute the Costas loop discriminator
     double carrier_discriminator = 0;
-    if (ip != 0)
+    if (acc[IP] != 0)
     {
-        carrier_discriminator = atan((double)qp / ip) / (2.0 * PI);
+        carrier_discriminator = atan((double)acc[QP] / acc[IP]) / (2.0 * PI);
     }
 
     // Filter the carrier discriminator
-    double carrier_error = pll->update(carrier_discriminator, 0.001); // Hz
+    double carrier_error = pll.update(carrier_discriminator, 0.001); // Hz
 
     // Update the carrier NCO
     carrier_rate = (fc + carrier_error) * 4 / fs;
 
     // Compute the normalized early-minus late power discriminator
-    double power_early = sqrt(ie * ie + qe * qe);
-    double power_late = sqrt(il * il + ql * ql);
+    double power_early = sqrt(acc[IE] * acc[IE] + acc[QE] * acc[QE]);
+    double power_late = sqrt(acc[IL] * acc[IL] + acc[QL] * acc[QL]);
     double code_discriminator = 0.5 * ((power_early - power_late) / (power_early + power_late));
 
     // Filter the code discriminator
-    double code_error = dll->update(code_discriminator, 0.001); // chips/s
+    double code_error = dll.update(code_discriminator, 0.001); // chips/s
 
     // Update the code NCO
     code_rate = (CHIP_RATE + code_error) / fs;
@@ -211,10 +135,10 @@ void SBASWAASTracker::update_epoch()
             nav_count++;
             bit_sum = 0;
         }
-        bit_sum += ip;
+        bit_sum += acc[IP];
     }
-    // Start bit sync when above threshold
-    else if (cn0 > BIT_SYNC_THRESHOLD || bit_sync_count != 0)
+    // Start bit sync when above threshold over a full C/N0 window
+    else if ((cn0 > BIT_SYNC_THRESHOLD && cn0_estimator.full()) || bit_sync_count != 0)
     {
         if (bit_sync_count >= BIT_SYNC_MS)
         {
@@ -237,7 +161,7 @@ void SBASWAASTracker::update_epoch()
                 bit_ms += 2;
         }
         // Update the bit sync histogram
-        bit_hist[bit_ms % 2] += ((ip > 0) != (last_ip > 0)) ? 1 : 0;
+        bit_hist[bit_ms % 2] += ((acc[IP] > 0) != (last_ip > 0)) ? 1 : 0;
         bit_sync_count++;
     }
 
@@ -251,13 +175,8 @@ void SBASWAASTracker::update_epoch()
     }
 
     // Reset the accumulators
-    last_ip = ip;
-    ie = 0;
-    qe = 0;
-    ip = 0;
-    qp = 0;
-    il = 0;
-    ql = 0;
+    last_ip = acc[IP];
+    memset(acc, 0, sizeof(acc));
 
     // Set the flag to indicate that this epoch has been processed
     epoch_processed = true;
@@ -287,28 +206,3 @@ void SBASWAASTracker::update_nav()
     }
 }
 
-void SBASWAASTracker::track(uint8_t *signal, long long size)
-{
-
-    // Per sample loop
-    for (int i = 0; i < size; i++)
-    {
-        update_sample(signal[i]);
-
-        // After accumulating and a new code epoch starts, we can process
-        // the accumulated values to update the tracking lock and bit recovery
-        if (code_gen->chip == 0)
-        {
-            if (!epoch_processed)
-            {
-                // Update the epoch
-                update_epoch();
-            }
-        }
-        else
-        {
-            // This resets the flag on chips other than 0
-            epoch_processed = false;
-        }
-    }
-}
\ No newline at end of file
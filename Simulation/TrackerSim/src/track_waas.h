@@ -4,9 +4,11 @@
 #include <stdint.h>
 #include "tools.h"
 #include "filters.h"
+#include "cn0_estimator.h"
+#include "tracker_core.h"
 // #include "ephm_waas.h"
 
-class SBASWAASTracker
+class SBASWAASTracker : public TrackerCore<SBASWAASTracker, WAASSignal>
 {
 public:
     SBASWAASTracker(
@@ -18,62 +20,48 @@ public:
 
     ~SBASWAASTracker();
 
-    void track(uint8_t *signal, long long size);
-
     double get_tx_time();
     void get_satellite_ecef(double t, double *x, double *y, double *z);
     double get_clock_correction(double t);
     bool ready_to_solve();
     double get_cn0() { return cn0; }
+    void set_cn0_algorithm(cn0_algorithm_t algorithm) { cn0_estimator.set_algorithm(algorithm); }
     int get_sv() { return sv; }
 
 private:
+    friend class TrackerCore<SBASWAASTracker, WAASSignal>;
+
+    // Accumulators
+    enum
+    {
+        IE,
+        QE,
+        IP,
+        QP,
+        IL,
+        QL
+    };
+
     int sv;
     double fs;
     double fc;
     double doppler;
     double code_off;
 
-    // NCOs
-    double code_phase;
-    double code_rate;
-    double carrier_phase;
-    double carrier_rate;
-
     // Code generator
     int start_chip;
-    WAASCodeGenerator *code_gen;
-
-    // Code generator outputs
-    uint8_t code_early;
-    uint8_t code_prompt;
-    uint8_t code_late;
-
-    // Accumulators (early, prompt, late for I and Q)
-    int ie;
-    int qe;
-    int ip;
-    int qp;
-    int il;
-    int ql;
-
-    // Variable to detect if this epoch has been processed
-    bool epoch_processed;
 
     // DLL filter
-    PLL *dll;
+    LoopFilter<2> dll;
 
     // PLL filter
-    PLL *pll;
+    LoopFilter<3> pll;
 
     // Time
     long long ms_elapsed;
 
-    // Prompt buffers
-    double ip_buffer[100];
-    double qp_buffer[100];
-    int prompt_len;
-    int prompt_idx;
+    // C/N0 over the last 100 prompt sums
+    CN0Estimator<100> cn0_estimator;
 
     // Bit sync
     int last_ip;
@@ -98,8 +86,6 @@ private:
     double cn0;
 
     // Private functions
-    void
-    update_sample(uint8_t signal_sample);
     void update_epoch();
     void update_nav();
 };
@@ -0,0 +1,781 @@
+#ifndef TRACKER_CORE_H
+#define TRACKER_CORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "tools.h"
+#include "correlator.h"
+#include "multi_correlator.h"
+
+// Signal policies for TrackerCore. The code taps sit from the earliest
+// (index 0, clocked from the code generator) to the latest (clocked one
+// chip behind), the ones in between taking the chip ahead of them at their
+// code phase threshold, half_el_spacing apart around the prompt at 0.5.
+//   CODE_CHIPS          Chips in a code period
+//   TAPS                Code taps, odd, the prompt in the middle
+//   DATA                A data replica with the prompt timing, not part of
+//                       the secondary code
+//   BOC                 BOC(1,1) subcarrier, high for the second half of
+//                       each prompt chip
+//   SECONDARY           The tracker's secondary_chip() inverts the taps
+//   CARRIER_STEP_FIRST  The local oscillator is read after the carrier NCO
+//                       steps rather than before
+//   data_chip()         The data replica chip at the code generator's chip
+
+struct L1CASignal
+{
+    typedef CACodeGenerator CodeGenerator;
+    static const int CODE_CHIPS = CA_CODE_LENGTH;
+    static const int TAPS = 3;
+    static const bool DATA = false;
+    static const bool BOC = false;
+    static const bool SECONDARY = false;
+    static const bool CARRIER_STEP_FIRST = false;
+    static uint8_t data_chip(CodeGenerator *) { return 0; }
+};
+
+struct WAASSignal
+{
+    typedef WAASCodeGenerator CodeGenerator;
+    static const int CODE_CHIPS = CA_CODE_LENGTH;
+    static const int TAPS = 3;
+    static const bool DATA = false;
+    static const bool BOC = false;
+    static const bool SECONDARY = false;
+    static const bool CARRIER_STEP_FIRST = false;
+    static uint8_t data_chip(CodeGenerator *) { return 0; }
+};
+
+struct E1Signal
+{
+    typedef GalileoE1CodeGenerator CodeGenerator;
+    static const int CODE_CHIPS = 4092;
+    static const int TAPS = 5;
+    static const bool DATA = true;
+    static const bool BOC = true;
+    static const bool SECONDARY = true;
+    static const bool CARRIER_STEP_FIRST = true;
+    static uint8_t data_chip(CodeGenerator *gen) { return gen->get_data_chip(); }
+};
+
+// Sample-rate half of a tracker: the NCOs, code taps and correlators, and
+// the track loops that call back into the tracker at each code epoch. The
+// tracker derives from TrackerCore<Tracker, Signal> and supplies
+// update_epoch(), which starts with end_epoch() and then reads and clears
+// acc. It can hide any of the
+// functions the loops call through it (update_sample(), track_packed(),
+// samples_to_epoch()) to add paths of its own.
+template <class Tracker, class Signal>
+class TrackerCore
+{
+public:
+    // Replicas correlated, the taps then the data replica
+    static const int REPLICAS = Signal::TAPS + (Signal::DATA ? 1 : 0);
+
+    void track(const uint8_t *signal, long long size);
+    // LSB-first packed samples, correlated 64 at a time. The size need not
+    // be a multiple of 64: the last word then holds size % 64 samples and
+    // is correlated on its own, and the NCOs, chips and accumulators carry
+    // into the next call, so blocks of any size track as one.
+    void track_packed(const uint64_t *words, long long size);
+    // Bit-sliced correlation (the default) or one sample at a time, the
+    // accumulators are identical either way
+    void set_bit_sliced(bool enable) { bit_sliced = enable; }
+    // Sample the correlation function at ntaps code offsets spacing chips
+    // apart around the prompt (the pilot, subcarrier included, for BOC
+    // signals), read each epoch from get_taps(). Computed on the exact
+    // bit-sliced path only, 0 taps turns them off.
+    void set_taps(int ntaps, double spacing);
+    MultiCorrelator *get_taps() { return taps; }
+    // Multi-bit real samples such as MultiBitFile::read_values() returns,
+    // correlated against 16-phase carrier LUTs with the double NCOs
+    void track_values(const int8_t *samples, long long size);
+    // Baseband I/Q from a Decimator, construct with its output rate and an IF of 0
+    void track_iq(const int8_t *i_samples, const int8_t *q_samples, long long size);
+
+    double get_code_rate() { return code_rate; }
+    double get_carrier_rate() { return carrier_rate; }
+
+protected:
+    TrackerCore();
+    ~TrackerCore();
+
+    // NCOs
+    double code_phase;
+    double code_rate;
+    double carrier_phase;
+    double carrier_rate;
+
+    // Code generator, owned
+    typename Signal::CodeGenerator *code_gen;
+
+    // Code generator outputs, earliest tap first
+    uint8_t code_chips[Signal::TAPS];
+    uint8_t code_data;
+    uint8_t boc1;
+
+    // Distance of the taps next to the prompt
+    double half_el_spacing;
+
+    // Accumulators, I and Q of each replica
+    int acc[2 * REPLICAS];
+
+    // Variable to detect if this epoch has been processed
+    bool epoch_processed;
+
+    // Correlate packed words with popcount, queued for the SIMD kernel
+    bool bit_sliced;
+    CorrelatorBatch *correlator;
+    MacBatch *mac;
+
+    // Extra code taps, NULL when off
+    MultiCorrelator *taps;
+
+    // No secondary code unless the tracker hides this
+    uint8_t secondary_chip() { return 0; }
+
+    void update_code();
+    void update_sample(uint8_t signal_sample);
+    void update_sample_values(int8_t signal_sample);
+    void update_sample_iq(int8_t i, int8_t q);
+    void update_word(uint64_t signal, int n);
+    void accumulate_word(uint64_t signal, uint64_t lo_i, uint64_t lo_q,
+                         const uint64_t *code, uint64_t boc, uint64_t mask);
+    void correlate_taps(uint64_t signal, uint64_t lo_i, uint64_t lo_q, uint64_t mask,
+                        double position, double step);
+    void flush_correlator();
+    void end_epoch();
+    long long samples_to_epoch();
+    void poll_epoch();
+
+private:
+    static const int PROMPT = Signal::TAPS / 2;
+
+    Tracker *self() { return static_cast<Tracker *>(this); }
+
+    // Code phase where tap t (between the earliest and the latest) takes
+    // the chip ahead of it
+    double tap_threshold(int t)
+    {
+        return (t == PROMPT) ? 0.5 : 0.5 + (t - PROMPT) * half_el_spacing;
+    }
+
+    // Subcarrier and secondary chip shared by the taps
+    uint8_t pilot_chip()
+    {
+        return (Signal::BOC ? boc1 : 0) ^ (Signal::SECONDARY ? self()->secondary_chip() : 0);
+    }
+
+    void fill_replicas(uint64_t *code, uint64_t *boc, int from, int to);
+};
+
+template <class Tracker, class Signal>
+TrackerCore<Tracker, Signal>::TrackerCore()
+{
+    code_phase = 0;
+    code_rate = 0;
+    carrier_phase = 0;
+    carrier_rate = 0;
+    code_gen = NULL;
+
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        code_chips[t] = 0;
+    }
+    code_data = 0;
+    boc1 = 0;
+    half_el_spacing = 0.5;
+
+    for (int k = 0; k < 2 * REPLICAS; k++)
+    {
+        acc[k] = 0;
+    }
+
+    epoch_processed = false;
+    bit_sliced = true;
+    correlator = new CorrelatorBatch(REPLICAS);
+    mac = new MacBatch(REPLICAS);
+    taps = NULL;
+}
+
+template <class Tracker, class Signal>
+TrackerCore<Tracker, Signal>::~TrackerCore()
+{
+    delete correlator;
+    delete mac;
+    delete taps;
+    delete code_gen;
+}
+
+// Clock the code NCO, the code chips and the BOC subcarrier
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::update_code()
+{
+    // Taps between the earliest and the latest, earliest first
+    for (int t = 1; t < Signal::TAPS - 1; t++)
+    {
+        if (code_phase >= tap_threshold(t))
+        {
+            code_chips[t] = code_chips[t - 1];
+            if (t == PROMPT)
+            {
+                if (Signal::DATA)
+                {
+                    code_data = Signal::data_chip(code_gen);
+                }
+
+                // Falling edge of BOC1
+                if (Signal::BOC)
+                {
+                    boc1 = 0;
+                }
+            }
+        }
+    }
+
+    // Earliest code chip (first to change)
+    // Latest code chip (clocked at the same time, but 1 chip behind)
+    if (code_phase >= 1)
+    {
+        code_chips[Signal::TAPS - 1] = code_chips[Signal::TAPS - 2];
+
+        code_gen->clock_chip();
+        code_chips[0] = code_gen->get_chip();
+
+        code_phase -= 1.0;
+
+        // Rising edge of BOC1
+        if (Signal::BOC)
+        {
+            boc1 = 1;
+        }
+    }
+
+    // Update the code NCO
+    code_phase += code_rate;
+}
+
+// Update the tracker with a new sample
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::update_sample(uint8_t signal_sample)
+{
+    // Get the local oscillator signals
+    uint8_t lo_i = carrier_sin[int(carrier_phase)];
+    uint8_t lo_q = carrier_cos[int(carrier_phase)];
+
+    // Update the carrier NCO
+    carrier_phase += carrier_rate;
+    if (carrier_phase >= 4)
+    {
+        carrier_phase -= 4;
+    }
+    if (Signal::CARRIER_STEP_FIRST)
+    {
+        lo_i = carrier_sin[int(carrier_phase)];
+        lo_q = carrier_cos[int(carrier_phase)];
+    }
+
+    // Get the code chips
+    update_code();
+
+    // Update the accumulators, the taps with the subcarrier and secondary
+    // chip folded into the sample
+    uint8_t sample = signal_sample ^ pilot_chip();
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        acc[2 * t] += (sample ^ lo_i ^ code_chips[t]) ? 1 : -1;
+        acc[2 * t + 1] += (sample ^ lo_q ^ code_chips[t]) ? 1 : -1;
+    }
+    if (Signal::DATA)
+    {
+        uint8_t data = signal_sample ^ code_data ^ (Signal::BOC ? boc1 : 0);
+        acc[2 * Signal::TAPS] += (data ^ lo_i) ? 1 : -1;
+        acc[2 * Signal::TAPS + 1] += (data ^ lo_q) ? 1 : -1;
+    }
+}
+
+// Update the tracker with a new multi-bit sample
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::update_sample_values(int8_t signal_sample)
+{
+    // Get the local oscillator values
+    int phase = int(carrier_phase * 4) & 15;
+
+    // Update the carrier NCO
+    carrier_phase += carrier_rate;
+    if (carrier_phase >= 4)
+    {
+        carrier_phase -= 4;
+    }
+    if (Signal::CARRIER_STEP_FIRST)
+    {
+        phase = int(carrier_phase * 4) & 15;
+    }
+
+    // Get the code chips
+    update_code();
+
+    // Queue the products for the multiply-accumulate kernel
+    uint8_t pilot = pilot_chip();
+    int8_t code[REPLICAS];
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        code[t] = (int8_t)((code_chips[t] ^ pilot) ? 1 : -1);
+    }
+    if (Signal::DATA)
+    {
+        code[Signal::TAPS] = (int8_t)((code_data ^ (Signal::BOC ? boc1 : 0)) ? 1 : -1);
+    }
+    mac->add(signal_sample, carrier_sin16[phase], carrier_cos16[phase], code);
+}
+
+// Update the tracker with a new baseband I/Q sample
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::update_sample_iq(int8_t i, int8_t q)
+{
+    // Get the local oscillator signals (a phase just below 0 can wrap to 4.0)
+    int lo_i = carrier_sin[int(carrier_phase) & 3] ? 1 : -1;
+    int lo_q = carrier_cos[int(carrier_phase) & 3] ? 1 : -1;
+
+    // Update the carrier NCO, the rate is negative for negative Doppler
+    carrier_phase += carrier_rate;
+    if (carrier_phase >= 4)
+    {
+        carrier_phase -= 4;
+    }
+    else if (carrier_phase < 0)
+    {
+        carrier_phase += 4;
+    }
+    if (Signal::CARRIER_STEP_FIRST)
+    {
+        lo_i = carrier_sin[int(carrier_phase) & 3] ? 1 : -1;
+        lo_q = carrier_cos[int(carrier_phase) & 3] ? 1 : -1;
+    }
+
+    // Get the code chips
+    update_code();
+
+    // Carrier wipeoff, matching the real 1-bit products signal * lo
+    int wipe_i = i * lo_i - q * lo_q;
+    int wipe_q = i * lo_q + q * lo_i;
+
+    // Update the accumulators
+    uint8_t pilot = pilot_chip();
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        acc[2 * t] += (code_chips[t] ^ pilot) ? wipe_i : -wipe_i;
+        acc[2 * t + 1] += (code_chips[t] ^ pilot) ? wipe_q : -wipe_q;
+    }
+    if (Signal::DATA)
+    {
+        uint8_t data = code_data ^ (Signal::BOC ? boc1 : 0);
+        acc[2 * Signal::TAPS] += data ? wipe_i : -wipe_i;
+        acc[2 * Signal::TAPS + 1] += data ? wipe_q : -wipe_q;
+    }
+}
+
+// Extend the replica words (and the subcarrier) with the current chips
+// over samples from to to
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::fill_replicas(uint64_t *code, uint64_t *boc, int from, int to)
+{
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        code[t] = fill_bits(code[t], code_chips[t], from, to);
+    }
+    if (Signal::DATA)
+    {
+        code[Signal::TAPS] = fill_bits(code[Signal::TAPS], code_data, from, to);
+    }
+    if (Signal::BOC)
+    {
+        *boc = fill_bits(*boc, boc1, from, to);
+    }
+}
+
+// Queue the samples in mask for the correlator kernel. Each correlator bit
+// is the XOR of the signal, carrier and code bits, and a set bit counts +1,
+// so the sum over n samples is 2 * popcount - n. The BOC subcarrier is the
+// same for every replica, so it is folded into the signal, and the
+// secondary chip into the taps.
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::accumulate_word(uint64_t signal, uint64_t lo_i, uint64_t lo_q,
+                                                   const uint64_t *code, uint64_t boc, uint64_t mask)
+{
+    uint64_t secondary = (Signal::SECONDARY && self()->secondary_chip()) ? ~0ULL : 0;
+
+    uint64_t replicas[REPLICAS];
+    for (int t = 0; t < Signal::TAPS; t++)
+    {
+        replicas[t] = code[t] ^ secondary;
+    }
+    if (Signal::DATA)
+    {
+        replicas[Signal::TAPS] = code[Signal::TAPS];
+    }
+    correlator->add(signal ^ boc, lo_i, lo_q, replicas, mask);
+}
+
+// Correlate the extra taps over the samples in mask, the secondary chip as
+// in accumulate_word()
+template <class Tracker, class Signal>
+inline void TrackerCore<Tracker, Signal>::correlate_taps(uint64_t signal, uint64_t lo_i, uint64_t lo_q, uint64_t mask,
+                                                         double position, double step)
+{
+    if (taps == NULL)
+        return;
+
+    if (Signal::SECONDARY && self()->secondary_chip())
+    {
+        signal = ~signal;
+    }
+    taps->add(signal ^ lo_i, signal ^ lo_q, mask, position, step);
+}
+
+// Move the queued correlations into the accumulators
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::flush_correlator()
+{
+    correlator->flush(acc);
+    mac->flush(acc);
+}
+
+// Close the epoch: bring acc up to date and end the taps' epoch
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::end_epoch()
+{
+    flush_correlator();
+    if (taps != NULL)
+    {
+        taps->dump();
+    }
+}
+
+// Correlate a word of n packed samples. The NCOs step once per sample with
+// the same arithmetic as update_sample(), so the replica timing is exact,
+// but each step only records the carrier LUT index. update_code() only
+// changes the chips and the subcarrier when the code phase crosses one of
+// its thresholds, so it runs on those samples alone and the replica words
+// are filled in runs between them. The accumulators are then updated once
+// per word, or at the epoch when one falls inside it.
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::update_word(uint64_t signal, int n)
+{
+    uint64_t phases[2] = {0, 0};
+    int count[2] = {0, 0};
+    uint64_t code[REPLICAS] = {0};
+    uint64_t boc = 0;
+    int run = 0;   // First sample with the current chips
+    int first = 0; // First sample not yet accumulated
+
+    double carrier = carrier_phase;
+    double carrier_step = carrier_rate;
+    double code_pos = code_phase;
+    double code_step = code_rate;
+
+    // Prompt code phase at sample 0, for the taps
+    double position = code_gen->chip + code_pos - 0.5;
+
+    // Next code phase where update_code() has an effect, checked on the
+    // first sample
+    double threshold = code_pos;
+
+    // The epoch test only changes outcome when the chip does, so it runs
+    // on the first sample and after each chip clock
+    bool check_epoch = true;
+
+    int j = 0;
+    for (int half = 0; half < 2; half++)
+    {
+        uint64_t word = 0;
+        int end = (n < 32 * (half + 1)) ? n : 32 * (half + 1);
+        for (; j < end; j++)
+        {
+            if (!Signal::CARRIER_STEP_FIRST)
+            {
+                word = (word >> 2) | ((uint64_t)int(carrier) << 62);
+            }
+
+            // Update the carrier NCO
+            carrier += carrier_step;
+            if (carrier >= 4)
+            {
+                carrier -= 4;
+            }
+            if (Signal::CARRIER_STEP_FIRST)
+            {
+                word = (word >> 2) | ((uint64_t)int(carrier) << 62);
+            }
+
+            if (code_pos >= threshold)
+            {
+                fill_replicas(code, &boc, run, j);
+                run = j;
+
+                double before = code_pos;
+                int chip = code_gen->chip;
+                code_phase = code_pos;
+                update_code();
+                code_pos = code_phase;
+
+                // After a chip clock every threshold applies again
+                if (code_gen->chip != chip)
+                {
+                    threshold = tap_threshold(1);
+                    check_epoch = true;
+                }
+                else
+                {
+                    threshold = 1.0;
+                    for (int t = Signal::TAPS - 2; t >= 1; t--)
+                    {
+                        if (before < tap_threshold(t))
+                        {
+                            threshold = tap_threshold(t);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                code_pos += code_step;
+            }
+
+            if (check_epoch)
+            {
+                check_epoch = false;
+                if (code_gen->chip == 0)
+                {
+                    if (!epoch_processed)
+                    {
+                        // Samples first to j
+                        phases[half] = word;
+                        count[half] = j + 1 - 32 * half;
+                        fill_replicas(code, &boc, run, j + 1);
+                        run = j + 1;
+
+                        uint64_t lo_i;
+                        uint64_t lo_q;
+                        carrier_words(phases, count, &lo_i, &lo_q);
+                        uint64_t mask = (~0ULL >> (63 - j)) & ~((1ULL << first) - 1);
+                        accumulate_word(signal, lo_i, lo_q, code, boc, mask);
+                        correlate_taps(signal, lo_i, lo_q, mask, position, code_step);
+                        first = j + 1;
+
+                        // The epoch reads the NCO state, sets new rates and
+                        // can move the code phase and the tap spacing
+                        carrier_phase = carrier;
+                        code_phase = code_pos;
+                        self()->update_epoch();
+                        code_pos = code_phase;
+                        carrier_step = carrier_rate;
+                        code_step = code_rate;
+                        threshold = code_pos;
+                        position = code_gen->chip + code_pos - 0.5 - (j + 1) * code_step;
+                    }
+                }
+                else
+                {
+                    epoch_processed = false;
+                }
+            }
+        }
+        phases[half] = word;
+        count[half] = end - 32 * half;
+        if (count[half] < 0)
+            count[half] = 0;
+    }
+
+    if (first < n)
+    {
+        fill_replicas(code, &boc, run, n);
+
+        uint64_t lo_i;
+        uint64_t lo_q;
+        carrier_words(phases, count, &lo_i, &lo_q);
+        uint64_t mask = (~0ULL >> (64 - n)) & ~((1ULL << first) - 1);
+        accumulate_word(signal, lo_i, lo_q, code, boc, mask);
+        correlate_taps(signal, lo_i, lo_q, mask, position, code_step);
+    }
+
+    carrier_phase = carrier;
+    code_phase = code_pos;
+}
+
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::set_taps(int ntaps, double spacing)
+{
+    delete taps;
+    taps = NULL;
+    if (ntaps <= 0)
+        return;
+
+    // One code period from chip 0
+    typename Signal::CodeGenerator gen = *code_gen;
+    gen.chip = 0;
+    uint8_t chips[Signal::CODE_CHIPS];
+    for (int k = 0; k < Signal::CODE_CHIPS; k++)
+    {
+        chips[k] = gen.get_chip();
+        gen.clock_chip();
+    }
+    taps = new MultiCorrelator(chips, Signal::CODE_CHIPS, Signal::BOC, ntaps, spacing);
+}
+
+// Samples that can run before the next code epoch without checking for
+// it. Chip clocks land where the code phase reaches 1, 2, ... chips ahead,
+// and two samples of margin cover rounding in the NCO sums.
+template <class Tracker, class Signal>
+long long TrackerCore<Tracker, Signal>::samples_to_epoch()
+{
+    // An epoch waiting on chip 0 is processed on the next check
+    if ((code_gen->chip == 0 && !epoch_processed) || code_rate <= 0)
+        return 0;
+
+    int chips = Signal::CODE_CHIPS - code_gen->chip;
+    double samples = floor((chips - code_phase) / code_rate) - 2;
+    return (samples > 0) ? (long long)samples : 0;
+}
+
+// After a sample, process the epoch when the code has returned to chip 0
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::poll_epoch()
+{
+    // After accumulating and a new code epoch starts, we can process
+    // the accumulated values to update the tracking lock and bit recovery
+    if (code_gen->chip == 0)
+    {
+        if (!epoch_processed)
+        {
+            // Update the epoch
+            self()->update_epoch();
+        }
+    }
+    else
+    {
+        // This resets the flag on chips other than 0
+        epoch_processed = false;
+    }
+}
+
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::track(const uint8_t *signal, long long size)
+{
+    if (bit_sliced)
+    {
+        // Pack through a small staging block
+        uint64_t words[64];
+        for (long long pos = 0; pos < size; pos += 64 * 64)
+        {
+            long long n = (size - pos < 64 * 64) ? size - pos : 64 * 64;
+            pack_bits(signal + pos, words, n);
+            self()->track_packed(words, n);
+        }
+        return;
+    }
+
+    long long i = 0;
+    while (i < size)
+    {
+        // Samples that cannot reach the next epoch skip the epoch check
+        long long span = self()->samples_to_epoch();
+        if (span > size - i)
+        {
+            span = size - i;
+        }
+        for (long long end = i + span; i < end; i++)
+        {
+            self()->update_sample(signal[i]);
+        }
+        if (code_gen->chip != 0)
+        {
+            epoch_processed = false;
+        }
+
+        // Close to the epoch, check after every sample
+        if (i < size)
+        {
+            self()->update_sample(signal[i]);
+            i++;
+            poll_epoch();
+        }
+    }
+}
+
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::track_packed(const uint64_t *words, long long size)
+{
+    for (long long pos = 0; pos < size; pos += 64)
+    {
+        int n = (size - pos < 64) ? (int)(size - pos) : 64;
+        update_word(words[pos / 64], n);
+    }
+    flush_correlator();
+}
+
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::track_values(const int8_t *samples, long long size)
+{
+    long long i = 0;
+    while (i < size)
+    {
+        // Samples that cannot reach the next epoch skip the epoch check
+        long long span = samples_to_epoch();
+        if (span > size - i)
+        {
+            span = size - i;
+        }
+        for (long long end = i + span; i < end; i++)
+        {
+            update_sample_values(samples[i]);
+        }
+        if (code_gen->chip != 0)
+        {
+            epoch_processed = false;
+        }
+
+        // Close to the epoch, check after every sample
+        if (i < size)
+        {
+            update_sample_values(samples[i]);
+            i++;
+            poll_epoch();
+        }
+    }
+    flush_correlator();
+}
+
+template <class Tracker, class Signal>
+void TrackerCore<Tracker, Signal>::track_iq(const int8_t *i_samples, const int8_t *q_samples, long long size)
+{
+    long long i = 0;
+    while (i < size)
+    {
+        // Samples that cannot reach the next epoch skip the epoch check
+        long long span = samples_to_epoch();
+        if (span > size - i)
+        {
+            span = size - i;
+        }
+        for (long long end = i + span; i < end; i++)
+        {
+            update_sample_iq(i_samples[i], q_samples[i]);
+        }
+        if (code_gen->chip != 0)
+        {
+            epoch_processed = false;
+        }
+
+        // Close to the epoch, check after every sample
+        if (i < size)
+        {
+            update_sample_iq(i_samples[i], q_samples[i]);
+            i++;
+            poll_epoch();
+        }
+    }
+}
+
+#endif // TRACKER_CORE_H